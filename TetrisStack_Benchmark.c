@@ -0,0 +1,259 @@
+/* ============================================================= */
+/*  TETRIS STACK – MICRO-BENCHMARKS DA BIBLIOTECA               */
+/* ============================================================= */
+/*  Mede cada função da fila, da pilha e do histórico isolada,  */
+/*  com as mensagens das ações desligadas (modoSilencioso).     */
+/*  Os três níveis usam a mesma biblioteca, então um benchmark  */
+/*  só cobre todos eles:                                         */
+/*    make benchmark                                             */
+/*                                                               */
+/*  Para cada função mostra: ns/op (média), p50, p99 e          */
+/*  ciclos/op. Cada amostra mede UMA chamada; o que a função    */
+/*  precisa antes de rodar (fila cheia, pilha com peça...) é    */
+/*  preparado fora da parte cronometrada.                       */
+/* ============================================================= */
+
+#include <stdio.h>      // printf, fprintf
+#include <stdlib.h>     // qsort, strtoull, malloc
+#include <stddef.h>     // offsetof
+#include <string.h>     // memcpy, strcmp
+#include <time.h>       // timespec_get, para calibrar o relógio
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>  // __rdtsc: contador de ciclos do processador
+#define TEM_CICLOS 1
+#else
+#define TEM_CICLOS 0
+#endif
+
+/* ------------------- MOTOR DO JOGO (libtetrisstack) ---------- */
+#include "tetrisstack.h"
+
+/* ------------------- CONFIGURAÇÕES --------------------------- */
+#define AMOSTRAS 200000                 // Quantas chamadas medimos de cada função
+static long long amostras[AMOSTRAS];    // Tempo (em ticks) de cada chamada
+static volatile int sumidouro;          // Impede o compilador de jogar fora resultados
+
+/* ============================================================= */
+/*  Relógio: ciclos quando o processador oferece (x86), senão   */
+/*  nanossegundos do timespec_get                               */
+/* ============================================================= */
+static long long agoraNs() {
+    struct timespec t;
+    timespec_get(&t, TIME_UTC);
+    return (long long)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+static inline long long lerTicks() {
+#if TEM_CICLOS
+    _mm_lfence();                       // Espera as instruções anteriores terminarem
+    long long t = (long long)__rdtsc();
+    _mm_lfence();
+    return t;
+#else
+    return agoraNs();
+#endif
+}
+
+static double nsPorTick = 1.0;          // Conversão de ticks para nanossegundos
+static long long custoRelogio = 0;      // Quanto custa só ler o relógio duas vezes
+
+/* ============================================================= */
+/*  Função: calibrar()                                           */
+/*  Descobre quantos ns vale um tick e o custo do próprio       */
+/*  relógio, que é descontado de cada amostra                   */
+/* ============================================================= */
+static void calibrar() {
+#if TEM_CICLOS
+    long long n0 = agoraNs(), c0 = lerTicks();
+    while (agoraNs() - n0 < 50000000LL) { }   // Espera 50 ms
+    long long n1 = agoraNs(), c1 = lerTicks();
+    nsPorTick = (double)(n1 - n0) / (double)(c1 - c0);
+#endif
+    long long menor = -1;
+    for (int i = 0; i < 10000; i++) {         // O menor custo observado é o custo "puro"
+        long long t0 = lerTicks();
+        long long t1 = lerTicks();
+        if (menor < 0 || t1 - t0 < menor) menor = t1 - t0;
+    }
+    custoRelogio = menor;
+}
+
+static int compararLL(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+/* ============================================================= */
+/*  Função: medir()                                              */
+/*  Roda preparar() (fora do tempo) e operacao() (cronometrada) */
+/*  AMOSTRAS vezes e imprime as estatísticas                    */
+/* ============================================================= */
+static void medir(const char *nome, void (*preparar)(void), void (*operacao)(void)) {
+    for (int i = 0; i < 1000; i++) { preparar(); operacao(); }   // Aquecimento
+
+    long long soma = 0;
+    for (int i = 0; i < AMOSTRAS; i++) {
+        preparar();
+        long long t0 = lerTicks();
+        operacao();
+        long long t1 = lerTicks();
+        long long d = t1 - t0 - custoRelogio;
+        if (d < 0) d = 0;
+        amostras[i] = d;
+        soma += d;
+    }
+    qsort(amostras, AMOSTRAS, sizeof amostras[0], compararLL);
+
+    double media = (double)soma / AMOSTRAS;
+    char ciclos[16] = "n/d";                 // Sem contador de ciclos → "não disponível"
+    if (TEM_CICLOS) snprintf(ciclos, sizeof ciclos, "%.1f", media);
+    printf("%-24s %9.2f %9.2f %9.2f %11s\n", nome,
+            media * nsPorTick,
+            amostras[AMOSTRAS / 2] * nsPorTick,
+            amostras[AMOSTRAS * 99 / 100] * nsPorTick,
+            ciclos);
+}
+
+/* ============================================================= */
+/*  Preparações e operações medidas                             */
+/* ============================================================= */
+static void nada() { }
+
+/* ---------- Fila + pilha + histórico ---------- */
+// Um jogo só (o Jogo inteiro, não mais variáveis globais) e uma cópia
+// "padrão" da parte quente (fila cheia e pilha cheia), restaurada antes
+// das operações que bagunçam tudo (inverter, trocar...).
+static Jogo jogo;
+static Jogo base;
+static Estado foto;
+
+static void guardarBase()   { memcpy(&base, &jogo, offsetof(Jogo, gerador)); }
+static void restaurarBase() { memcpy(&jogo, &base, offsetof(Jogo, gerador)); }
+static void abrirVaga()    { restaurarBase(); dequeue(&jogo); }
+static void aposJogada()   { restaurarBase(); salvarEstado(&jogo, &foto); jogarPeca(&jogo); }
+static void comHistorico() { aposJogada(); registrarDelta(&jogo, &foto); }
+static void comRefazer()   { comHistorico(); desfazer(&jogo); }
+static void pilhaComVaga() { restaurarBase(); jogo.topo--; jogo.qtdPilha--; }
+static void opGerarPeca()  { Peca p = gerarPeca(&jogo); sumidouro = p.id; }
+static void opEnqueue()    { enqueue(&jogo); }
+static void opDequeue()    { Peca p = dequeue(&jogo); sumidouro = p.id; }
+static void opReservar()   { reservarPeca(&jogo); }
+static void opUsar()       { usarReservada(&jogo); }
+static void opSalvar()     { salvarEstado(&jogo, &foto); }
+static void opRegistrar()  { registrarDelta(&jogo, &foto); }
+static void opDesfazer()   { desfazer(&jogo); }
+static void opRefazer()    { refazer(&jogo); }
+static void opTrocar()     { trocarTopoComFrente(&jogo); }
+static void opInverter()   { inverterFilaComPilha(&jogo); }
+static unsigned char loteBench[4096];
+static void opLote()       { gerarTiposEmLote(&jogo.gerador, loteBench, sizeof loteBench); sumidouro = loteBench[0]; }
+static unsigned char acoesBench[1024], resultadosBench[1024];
+static Peca jogadasBench[2 * 1024];              // Duas vagas por ação (a opção 3 joga duas)
+static void opAplicar()    { sumidouro = (int)aplicarAcoes(&jogo, acoesBench, 1024, resultadosBench, jogadasBench); }
+static unsigned char *snapshotBench;
+static size_t tamSnapshotBench;
+static void opSalvarSnapshot()    { sumidouro = (int)salvarSnapshot(&jogo, snapshotBench, tamSnapshotBench); }
+static void opRestaurarSnapshot() { sumidouro = restaurarSnapshot(&jogo, snapshotBench, tamSnapshotBench); }
+static Jogo ramoBench;
+static void prepararRamo() { liberarJogo(&ramoBench); comHistorico(); }   // Com algo para congelar
+static void opBifurcar()   { bifurcarJogo(&ramoBench, &jogo); }
+static void usarSaco()     { jogo.gerador.modo = MODO_SACO; }
+static void usarSorteio()  { jogo.gerador.modo = MODO_ALEATORIO; }
+
+// Tabuleiro: um campo "de meio de partida" (umas linhas ocupadas,
+// com buracos), restaurado antes de cada soltarPeca()
+static Campo campo, campoBase;
+static int rotacaoBench, colunaBench;
+static void restaurarCampo()  { campo = campoBase; }
+static void opSoltar()        { sumidouro = soltarPeca(&campo, 2, 1, 4); }
+static void opEncaixe()       { escolherEncaixe(&campo, 2, &rotacaoBench, &colunaBench); sumidouro = colunaBench; }
+static void opCompletas()     { sumidouro = (int)linhasCompletas(&campo); }
+static void opAvaliar()       { sumidouro = avaliarCampo(&campo); }
+
+#ifdef TEM_COMPACTO
+// Mesmas ações na forma compacta (um uint64_t). "volatile" obriga o
+// compilador a ler e gravar o estado a cada chamada, como no jogo.
+static volatile EstadoCompacto compacto, compactoBase;
+static void restaurarCompacto() { compacto = compactoBase; }
+static void opCompactoJogar()     { compacto = compactoJogar(compacto, 3); }
+static void opCompactoReservar()  { compacto = compactoReservar(compacto, 3); }
+static void opCompactoUsar()      { compacto = compactoUsarReservada(compacto, 3); }
+static void opCompactoTrocar()    { compacto = compactoTrocar(compacto); }
+static void opCompactoInverter()  { compacto = compactoInverter(compacto); }
+static void opCompactoCopiar()    { EstadoCompacto e = compacto; sumidouro = (int)hashCompacto(e); }
+static void pilhaCompactoComVaga() {
+    EstadoCompacto e = compactoBase;
+    compacto = (e & ~(7ULL << (DESLOC_PILHA_C + BITS_TIPO * (TAM_PILHA - 1)))) - (1ULL << DESLOC_QTD_PILHA_C);
+}
+#endif
+
+static void rodarTudo(unsigned long long semente) {
+    modoSilencioso = 1;
+    GeradorPecas gerador;
+    iniciarGerador(&gerador, semente, MODO_ALEATORIO);
+    iniciarJogo(&jogo, &gerador);
+    while (jogo.qtdPilha < TAM_PILHA) reservarPeca(&jogo);   // Pilha cheia para trocar/inverter
+    guardarBase();
+
+    medir("gerarPeca()", nada, opGerarPeca);
+    medir("gerarTiposEmLote(4096)", usarSorteio, opLote);
+    medir("  ... modo 7-bag", usarSaco, opLote);
+    usarSorteio();
+    medir("enqueue()", abrirVaga, opEnqueue);
+    medir("dequeue()", restaurarBase, opDequeue);
+    medir("reservarPeca() (push)", pilhaComVaga, opReservar);
+    medir("usarReservada() (pop)", restaurarBase, opUsar);
+    medir("salvarEstado()", restaurarBase, opSalvar);
+    medir("registrarDelta()", aposJogada, opRegistrar);
+    medir("desfazer()", comHistorico, opDesfazer);
+    medir("refazer()", comRefazer, opRefazer);
+    medir("trocarTopoComFrente()", restaurarBase, opTrocar);
+    medir("inverterFilaComPilha()", restaurarBase, opInverter);
+    medir("bifurcarJogo()", prepararRamo, opBifurcar);
+    GeradorPecas sorteioAcoes;
+    iniciarGerador(&sorteioAcoes, semente, MODO_ALEATORIO);
+    for (int i = 0; i < 1024; i++) acoesBench[i] = (unsigned char)(1 + sortearAte(&sorteioAcoes, 7));
+    medir("aplicarAcoes(1024)", restaurarBase, opAplicar);
+    tamSnapshotBench = tamanhoSnapshot(&jogo);    // Com o histórico que o aplicarAcoes deixou
+    snapshotBench = malloc(tamSnapshotBench);
+    if (snapshotBench != NULL) {
+        salvarSnapshot(&jogo, snapshotBench, tamSnapshotBench);
+        medir("salvarSnapshot()", nada, opSalvarSnapshot);
+        medir("restaurarSnapshot()", nada, opRestaurarSnapshot);
+        free(snapshotBench);
+    }
+    liberarJogo(&ramoBench);
+    GeradorPecas pecasCampo;
+    iniciarGerador(&pecasCampo, semente, MODO_SACO);
+    for (int k = 0; k < 24; k++)                  // Pousa algumas peças bem e outras em qualquer lugar
+        soltarPeca(&campoBase, (int)sortearAte(&pecasCampo, 7), 0, (int)sortearAte(&pecasCampo, LARGURA_TAB - 3));
+    medir("soltarPeca()", restaurarCampo, opSoltar);
+    medir("linhasCompletas()", restaurarCampo, opCompletas);
+    medir("avaliarCampo()", restaurarCampo, opAvaliar);
+    medir("escolherEncaixe()", restaurarCampo, opEncaixe);
+#ifdef TEM_COMPACTO
+    compactoBase = compactar(&base);
+    medir("compactoJogar()", restaurarCompacto, opCompactoJogar);
+    medir("compactoReservar()", pilhaCompactoComVaga, opCompactoReservar);
+    medir("compactoUsarReservada()", restaurarCompacto, opCompactoUsar);
+    medir("compactoTrocar()", restaurarCompacto, opCompactoTrocar);
+    medir("compactoInverter()", restaurarCompacto, opCompactoInverter);
+    medir("hashCompacto()", restaurarCompacto, opCompactoCopiar);
+#endif
+    liberarJogo(&jogo);
+}
+
+/* ============================================================= */
+/*  main() do benchmark                                          */
+/* ============================================================= */
+int main(int argc, char *argv[]) {
+    unsigned long long semente = 12345;    // Semente fixa: execuções comparáveis
+    if (argc > 2 && strcmp(argv[1], "--seed") == 0) semente = strtoull(argv[2], NULL, 10);
+
+    calibrar();
+    printf("=== BENCHMARK – libtetrisstack (%d amostras por função) ===\n", AMOSTRAS);
+    printf("%-24s %9s %9s %9s %11s\n", "função", "ns/op", "p50 ns", "p99 ns", "ciclos/op");
+    rodarTudo(semente);
+    return 0;
+}
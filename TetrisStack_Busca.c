@@ -0,0 +1,722 @@
+/* ============================================================= */
+/*  TETRIS STACK – BUSCA DA MELHOR JOGADA (LOOKAHEAD)           */
+/* ============================================================= */
+/*  Decide entre jogar, reservar, usar reservada, trocar e      */
+/*  inverter olhando várias jogadas à frente.                   */
+/*                                                               */
+/*    make busca                                                */
+/*    ./busca --depth 8 --moves 10000 --seed 42                 */
+/*                                                               */
+/*  Como funciona:                                               */
+/*    - o estado é o EstadoCompacto (um uint64_t), então gerar  */
+/*      um filho é um punhado de shifts, sem copiar Estado      */
+/*    - as peças que vão entrar na fila são conhecidas (uma     */
+/*      cópia do gerador diz quais serão: espiarTipos)          */
+/*    - aprofundamento iterativo: busca com profundidade 1, 2,  */
+/*      3... até a profundidade máxima ou o tempo acabar        */
+/*    - tabela de transposição com hash de Zobrist: trocar duas */
+/*      vezes, inverter duas vezes etc. chegam no MESMO estado, */
+/*      que só é calculado uma vez                               */
+/*    - ordenação: primeiro a jogada que a tabela guardou (a    */
+/*      melhor da iteração anterior), depois as que pontuam     */
+/*    - corte por limite: se nem pontuando o máximo em todas as */
+/*      jogadas restantes dá para passar a melhor já achada, o  */
+/*      ramo é abandonado                                        */
+/*                                                               */
+/*  A pontuação é plugável (struct Pontuacao): quanto vale      */
+/*  jogar cada tipo de peça, quanto vale (ou custa) o estado    */
+/*  depois de cada jogada e quanto vale o estado no fim. A      */
+/*  padrão cobra uma multa por jogada sem nenhuma 'I' à mão     */
+/*  (seca de 'I'): é isso que dá motivo para reservar.          */
+/*                                                               */
+/*  Desfazer/refazer ficam de fora da busca: desfazer só volta  */
+/*  para um estado que a própria busca já avaliou.              */
+/*                                                               */
+/*  Tabela de decisão (sem busca na hora de jogar):             */
+/*    ./busca --build-table tabela.tdt [--horizon 12]           */
+/*    ./busca --table tabela.tdt --moves 10000                  */
+/*  O gerador calcula a melhor jogada para todo estado de fila  */
+/*  cheia supondo peças novas sorteadas (1/7 cada tipo), e a    */
+/*  partida decide com uma consulta à tabela por jogada.        */
+/*  --c-header tabela.h grava também um array C; compilando com */
+/*  -DTABELA_EMBUTIDA='"tabela.h"', use --table builtin.        */
+/* ============================================================= */
+
+#define _GNU_SOURCE     // pthread_barrier_t
+#include <stdio.h>      // printf, fprintf
+#include <stdlib.h>     // malloc, free, qsort, strtoull
+#include <stdint.h>     // uint64_t
+#include <string.h>     // strcmp, memset
+#include <time.h>       // timespec_get: limite de tempo e medições
+#include <pthread.h>    // O gerador da tabela divide os estados entre threads
+#include <unistd.h>     // sysconf, close
+#include <fcntl.h>      // open (ler a tabela com mmap)
+#include <sys/mman.h>   // mmap
+#include <sys/stat.h>   // fstat (tamanho do arquivo)
+
+/* ------------------- MOTOR DO JOGO (libtetrisstack) ---------- */
+#include "tetrisstack.h"
+
+#ifndef TEM_COMPACTO
+#error "a busca usa o EstadoCompacto: TAM_FILA/TAM_PILHA grandes demais"
+#endif
+
+/* ------------------- PONTUAÇÃO (plugável) ------------------- */
+typedef struct {
+    int valorJogada[7];                         // Pontos por jogar cada tipo (I, O, T, L, J, S, Z)
+    int valorPar[7][7];                         // Bônus do "usar reservada" por [topo][frente] jogadas juntas
+    int custoEspera;                            // Custo das jogadas que não põem peça (reservar, trocar, inverter)
+    int (*avaliarPasso)(EstadoCompacto depois, const void *ctx);   // Somado a cada jogada (NULL = nada)
+    int maxPasso;                               // Maior valor que avaliarPasso pode dar (para o corte)
+    int (*avaliarFolha)(EstadoCompacto e, const void *ctx);   // Valor do estado no fim da busca
+    int maxFolha;                               // Maior valor que avaliarFolha pode dar (para o corte)
+    const void *ctx;                            // Dados extras para avaliarPasso e avaliarFolha
+} Pontuacao;
+
+// Quantas 'I' (tipo 0) há na fila e na reserva
+static int contarI(EstadoCompacto e) {
+    int n = 0;
+    for (int c = 0; c < compactoQtdFila(e); c++) n += ((e >> (BITS_TIPO * c)) & 7) == 0;
+    for (int c = 0; c < compactoQtdPilha(e); c++) n += ((e >> (DESLOC_PILHA_C + BITS_TIPO * c)) & 7) == 0;
+    return n;
+}
+
+// Seca de 'I': sem nenhuma 'I' na fila nem na reserva, o poço que o
+// jogador deixou aberto não tem como ser fechado, e cada jogada nessa
+// situação custa MULTA_SECA_I. Guardar uma 'I' na reserva evita a multa,
+// mas custa os pontos de jogá-la agora: a busca tem que pesar os dois.
+#define MULTA_SECA_I 3
+
+static int passoPadrao(EstadoCompacto depois, const void *ctx) {
+    (void)ctx;
+    return contarI(depois) == 0 ? -MULTA_SECA_I : 0;
+}
+
+// Padrão: a 'I' vale mais; no fim, cada 'I' guardada (fila ou reserva)
+// vale metade, para a busca não "queimar" todas as 'I' no último passo
+static int folhaPadrao(EstadoCompacto e, const void *ctx) {
+    (void)ctx;
+    return 2 * contarI(e);
+}
+
+// Peças que se encaixam num retângulo quando jogadas juntas (o "usar
+// reservada" joga a do topo e a da frente de uma vez): S com Z, L com
+// J, duas 'I' ou duas 'O' lado a lado. Esperar o par certo na reserva
+// (e trocar para alinhá-lo) só compensa olhando algumas jogadas à frente.
+#define BONUS_PAR 6
+
+// Reservar, trocar e inverter não põem peça nenhuma: sem um custo,
+// trocar sem parar "empurra" as multas da seca para depois do horizonte
+#define CUSTO_ESPERA 2
+
+const Pontuacao pontuacaoPadrao = {
+    { 4, 1, 2, 2, 2, 1, 1 },
+    //  Tipos: I = 0, O = 1, T = 2, L = 3, J = 4, S = 5, Z = 6
+    { [0][0] = BONUS_PAR, [1][1] = BONUS_PAR / 2,
+      [3][4] = BONUS_PAR, [4][3] = BONUS_PAR, [5][6] = BONUS_PAR, [6][5] = BONUS_PAR },
+    CUSTO_ESPERA, passoPadrao, 0, folhaPadrao, 2 * (TAM_FILA + TAM_PILHA), NULL
+};
+
+// A parte do ganho que só depende do estado de antes: as peças jogadas
+// (e o par) ou o custo de esperar
+static inline int ganhoFixo(const Pontuacao *p, EstadoCompacto antes, int op) {
+    if (op == 1) return p->valorJogada[compactoFrente(antes)];
+    if (op == 3) return p->valorJogada[compactoFrente(antes)] + p->valorJogada[compactoTopo(antes)]
+                      + p->valorPar[compactoTopo(antes)][compactoFrente(antes)];
+    return -p->custoEspera;                     // Reservar, trocar, inverter
+}
+
+// O que uma jogada feita rende: o ganho fixo mais o passo. Também soma
+// os pontos da partida de verdade.
+static inline int ganhoDaJogada(const Pontuacao *p, EstadoCompacto antes, int op, EstadoCompacto depois) {
+    int ganho = ganhoFixo(p, antes, op);
+    if (p->avaliarPasso != NULL) ganho += p->avaliarPasso(depois, p->ctx);
+    return ganho;
+}
+
+/* ------------------- TABELA DE TRANSPOSIÇÃO ----------------- */
+#define TT_EXATO    1                           // Valor exato do nó
+#define TT_TETO     2                           // Valor é só um teto (o nó foi cortado)
+
+typedef struct {
+    uint64_t chave;                             // Hash completo (confere colisões)
+    int32_t valor;
+    uint8_t profundidade;
+    uint8_t tipo;                               // TT_EXATO ou TT_TETO
+    uint8_t jogada;                             // Melhor jogada achada (código do menu)
+} EntradaTT;
+
+#define ACOES_BUSCA 5
+static const int acoesBusca[ACOES_BUSCA] = { 1, 3, 2, 4, 6 };   // Ordem base: as que pontuam primeiro
+#define MAX_PROFUNDIDADE 32
+#define MENOS_INFINITO (-1000000000)            // Longe de INT32_MIN: "alfa - ganho" não transborda
+
+typedef struct {
+    EntradaTT *tabela;
+    size_t mascara;                             // Tamanho da tabela - 1 (potência de 2)
+    uint64_t zobrist[9][256];                   // 8 bytes do estado + quantas peças novas já entraram
+    unsigned char futuro[MAX_PROFUNDIDADE];     // Próximos tipos do gerador
+    uint64_t sal;                               // Muda a cada decisão (as peças futuras mudaram)
+    const Pontuacao *pontuacao;
+    int ganhoMax;                               // Maior ganho possível numa jogada (usar reservada: 2 peças + passo)
+    long long prazoNs;                          // Quando parar (0 = sem limite)
+    int estourou;                               // O tempo acabou no meio de uma iteração
+    unsigned long long nos, acertosTT;
+} Busca;
+
+static long long agoraNs(void) {
+    struct timespec t;
+    timespec_get(&t, TIME_UTC);
+    return (long long)t.tv_sec * 1000000000LL + t.tv_nsec;
+}
+
+/* ============================================================= */
+/*  Função: iniciarBusca()                                       */
+/*  Aloca a tabela (2^bitsTabela entradas) e sorteia as chaves  */
+/*  de Zobrist                                                   */
+/* ============================================================= */
+int iniciarBusca(Busca *b, int bitsTabela, const Pontuacao *p) {
+    memset(b, 0, sizeof *b);
+    b->tabela = calloc((size_t)1 << bitsTabela, sizeof(EntradaTT));
+    if (b->tabela == NULL) return 0;
+    b->mascara = ((size_t)1 << bitsTabela) - 1;
+    GeradorPecas g;
+    iniciarGerador(&g, 0x5EED2B15ULL, MODO_ALEATORIO);
+    for (int i = 0; i < 9; i++)
+        for (int v = 0; v < 256; v++) b->zobrist[i][v] = proximoAleatorio(&g);
+    b->pontuacao = p;
+    int maior = 0;
+    for (int t = 0; t < 7; t++) if (p->valorJogada[t] > maior) maior = p->valorJogada[t];
+    int maiorPar = 0;
+    for (int t = 0; t < 7; t++)
+        for (int u = 0; u < 7; u++) if (p->valorPar[t][u] > maiorPar) maiorPar = p->valorPar[t][u];
+    b->ganhoMax = 2 * maior + maiorPar + (p->avaliarPasso != NULL ? p->maxPasso : 0);
+    return 1;
+}
+
+void liberarBusca(Busca *b) { free(b->tabela); b->tabela = NULL; }
+
+// Hash de Zobrist por bytes: um XOR de tabela por byte do estado
+static inline uint64_t chaveZobrist(const Busca *b, EstadoCompacto e, int usados) {
+    uint64_t h = b->zobrist[8][usados] ^ b->sal;
+    for (int i = 0; i < 8; i++) h ^= b->zobrist[i][(e >> (8 * i)) & 0xFF];
+    return h;
+}
+
+// Aplica a jogada "op" no estado compacto. "usados" = quantas peças
+// novas já entraram. Devolve 0 se a jogada for recusada (as mesmas
+// regras do jogo); senão 1, o novo estado em *filho e o ganho em *ganho
+// (que pode ser negativo: a multa do passo)
+static inline int aplicarJogada(const Busca *b, EstadoCompacto e, int usados, int op,
+                                EstadoCompacto *filho, int *novosUsados, int *ganho) {
+    int novo = b->futuro[usados];
+    int qF = compactoQtdFila(e), qP = compactoQtdPilha(e);
+    *novosUsados = usados;
+    switch (op) {
+        case 1:
+            if (qF == 0) return 0;
+            *filho = compactoJogar(e, novo);
+            (*novosUsados)++;
+            break;
+        case 2:
+            if (qF == 0 || qP >= TAM_PILHA) return 0;
+            *filho = compactoReservar(e, novo);
+            (*novosUsados)++;
+            break;
+        case 3:
+            if (qF == 0 || qP == 0) return 0;
+            *filho = compactoUsarReservada(e, novo);
+            (*novosUsados)++;
+            break;
+        case 4:
+            if (qF == 0 || qP == 0) return 0;
+            *filho = compactoTrocar(e);
+            break;
+        default:
+            if (qF == 0 || qP == 0) return 0;
+            *filho = compactoInverter(e);
+            break;
+    }
+    *ganho = ganhoDaJogada(b->pontuacao, e, op, *filho);
+    return 1;
+}
+
+/* ============================================================= */
+/*  Função: buscar()                                             */
+/*  Melhor pontuação a partir de "e" com "prof" jogadas.        */
+/*  Se o resultado for <= alfa, ele pode ser só um teto: o nó   */
+/*  não tem como passar de alfa e a busca desiste cedo.         */
+/* ============================================================= */
+static int buscar(Busca *b, EstadoCompacto e, int usados, int prof, int alfa) {
+    const Pontuacao *p = b->pontuacao;
+    if (prof == 0) return p->avaliarFolha(e, p->ctx);
+    b->nos++;
+    if ((b->nos & 1023) == 0 && b->prazoNs && agoraNs() > b->prazoNs) b->estourou = 1;
+    if (b->estourou) return alfa;                 // Resultado descartado pela raiz
+
+    int teto = prof * b->ganhoMax + p->maxFolha;
+    if (teto <= alfa) return teto;                // Nem o máximo possível passa de alfa
+
+    uint64_t chave = chaveZobrist(b, e, usados);
+    EntradaTT *t = &b->tabela[chave & b->mascara];
+    int jogadaTT = 0;
+    if (t->chave == chave) {
+        if (t->profundidade >= prof) {
+            if (t->tipo == TT_EXATO) { b->acertosTT++; return t->valor; }
+            if (t->valor <= alfa) { b->acertosTT++; return t->valor; }
+        }
+        jogadaTT = t->jogada;                     // Mesmo sem servir, a jogada guardada vai primeiro
+    }
+
+    int ordem[ACOES_BUSCA], n = 0;
+    if (jogadaTT) ordem[n++] = jogadaTT;
+    for (int i = 0; i < ACOES_BUSCA; i++) if (acoesBusca[i] != jogadaTT) ordem[n++] = acoesBusca[i];
+
+    int melhor = MENOS_INFINITO, melhorJogada = 0;
+    for (int i = 0; i < n; i++) {
+        EstadoCompacto filho;
+        int novosUsados, ganho;
+        if (!aplicarJogada(b, e, usados, ordem[i], &filho, &novosUsados, &ganho)) continue;   // Jogada recusada
+        if (filho == e && novosUsados == usados) continue;   // Não muda nada (ex.: trocar duas iguais)
+        int limite = (melhor > alfa ? melhor : alfa) - ganho;
+        int v = ganho + buscar(b, filho, novosUsados, prof - 1, limite);
+        if (v > melhor) { melhor = v; melhorJogada = ordem[i]; }
+    }
+    if (melhorJogada == 0) melhor = p->avaliarFolha(e, p->ctx);   // Nenhuma jogada possível
+    if (b->estourou) return melhor;
+
+    t->chave = chave;                             // Sempre substitui: a entrada mais nova é a mais útil
+    t->valor = melhor;
+    t->profundidade = (uint8_t)prof;
+    t->tipo = melhor > alfa ? TT_EXATO : TT_TETO;
+    t->jogada = (uint8_t)melhorJogada;
+    return melhor;
+}
+
+/* ============================================================= */
+/*  Função: decidirJogada()                                      */
+/*  Aprofundamento iterativo a partir do jogo atual. Devolve o  */
+/*  código da melhor jogada (1, 2, 3, 4 ou 6).                   */
+/* ============================================================= */
+int decidirJogada(Busca *b, const Jogo *j, int profMax, long long limiteNs, int *profAlcancada) {
+    if (profMax > MAX_PROFUNDIDADE) profMax = MAX_PROFUNDIDADE;
+    espiarTipos(&j->gerador, b->futuro, profMax);  // Cada jogada coloca no máximo 1 peça nova
+    EstadoCompacto e = compactar(j);
+    b->prazoNs = limiteNs > 0 ? agoraNs() + limiteNs : 0;
+    b->estourou = 0;
+    // "usados" só faz sentido junto com ESTE futuro: o sal novo deixa as
+    // entradas das decisões anteriores sem efeito (elas vão sendo trocadas)
+    b->sal = b->sal * 0x9E3779B97F4A7C15ULL + 0xD1B54A32D192ED03ULL;
+
+    int decisao = 1;
+    *profAlcancada = 0;
+    for (int prof = 1; prof <= profMax; prof++) {
+        buscar(b, e, 0, prof, MENOS_INFINITO);
+        if (b->estourou) break;                   // Iteração incompleta: fica com a anterior
+        EntradaTT *t = &b->tabela[chaveZobrist(b, e, 0) & b->mascara];
+        if (t->chave == chaveZobrist(b, e, 0) && t->jogada) decisao = t->jogada;
+        *profAlcancada = prof;
+    }
+    return decisao;
+}
+
+/* ------------------- TABELA DE DECISÃO ---------------------- */
+// Para a tabela as peças futuras NÃO são conhecidas: cada peça nova é
+// qualquer tipo com chance 1/7. O valor de um estado é o que se espera
+// pontuar dali em diante, com cada jogada futura valendo "desconto"
+// vezes a anterior (desconto = 1 - 1/horizonte). A iteração de valor
+// repete V(e) = max(ganho + desconto * média dos filhos) até os
+// valores pararem de mudar; a jogada que dá o máximo vai para a tabela.
+//
+// A pontuação é a mesma da busca (ganhoFixo + avaliarPasso do filho).
+// Com desconto < 1 trocar/inverter nunca ficam em ciclo: ir e voltar
+// custa a espera duas vezes, e jogar sempre pontua alguma coisa.
+//
+// As threads sobem uma vez só: a cada volta todas passam pela barreira
+// "largada", calculam o seu trecho e se encontram na "chegada".
+#define TOLERANCIA_TABELA 1e-4f       // Mudança máxima de um valor para parar
+#define MAX_VOLTAS_TABELA 5000
+
+typedef struct EquipeTabela EquipeTabela;
+
+typedef struct {
+    const Pontuacao *pontuacao;
+    const float *passo;               // avaliarPasso de cada estado (calculado uma vez)
+    const float *antes;               // Valores da volta anterior
+    float *depois;                    // Valores desta volta
+    unsigned char *decisoes;
+    float desconto;
+    uint64_t inicio, fim;             // Estados deste trecho (inicio par: cada byte é de um trecho só)
+    float maiorMudanca;
+    uint64_t mudancas;                // Decisões que mudaram nesta volta
+    EquipeTabela *equipe;
+} TrechoTabela;
+
+struct EquipeTabela {
+    pthread_mutex_t portao;           // Segura as threads até as barreiras existirem
+    pthread_barrier_t largada, chegada;
+    int parar;                        // Lido depois da largada: 1 = a tabela acabou
+};
+
+// O contrário de indiceTabela(): monta o estado de fila cheia do índice i
+static EstadoCompacto estadoDoIndice(uint64_t i) {
+    uint64_t estadosFila = potencia7(TAM_FILA);
+    uint64_t fila = i % estadosFila, resto = i / estadosFila, grupo = 1;
+    int qP = 0;
+    while (resto >= grupo) { resto -= grupo; grupo *= 7; qP++; }   // Tira os grupos de pilha menor
+    EstadoCompacto e = 0;
+    for (int c = TAM_FILA - 1; c >= 0; c--) { e |= (fila % 7) << (BITS_TIPO * c); fila /= 7; }
+    for (int c = 0; c < qP; c++) { e |= (resto % 7) << (DESLOC_PILHA_C + BITS_TIPO * c); resto /= 7; }
+    return e | ((uint64_t)TAM_FILA << DESLOC_QTD_FILA_C) | ((uint64_t)qP << DESLOC_QTD_PILHA_C);
+}
+
+// Valor esperado depois de uma jogada que coloca peça nova: o filho com
+// a peça 0 está em "base" e os outros 6 logo depois (a peça nova é o
+// dígito mais baixo do índice). Cada filho vale o passo dele mais o
+// valor dele descontado.
+static inline float mediaFilhos(const TrechoTabela *t, EstadoCompacto filhoComZero) {
+    uint64_t k = indiceTabela(filhoComZero);
+    const float *v = t->antes + k, *passo = t->passo + k;
+    float soma = 0;
+    for (int c = 0; c < 7; c++) soma += passo[c] + t->desconto * v[c];
+    return soma * (1.0f / 7);
+}
+
+/* ============================================================= */
+/*  Função: calcularTrecho()                                     */
+/*  Uma volta da iteração de valor nos estados [inicio, fim)    */
+/* ============================================================= */
+static void calcularTrecho(TrechoTabela *t) {
+    const Pontuacao *p = t->pontuacao;
+    const float *antes = t->antes;
+    t->maiorMudanca = 0;
+    t->mudancas = 0;
+    for (uint64_t i = t->inicio; i < t->fim; i++) {
+        EstadoCompacto e = estadoDoIndice(i);
+        int qP = compactoQtdPilha(e);
+        float melhor = MENOS_INFINITO;
+        int jogada = 0;
+        for (int k = 0; k < ACOES_BUSCA; k++) {   // Mesma ordem da busca: no empate fica a primeira
+            int op = acoesBusca[k];
+            float v;
+            if (op == 1) {
+                v = ganhoFixo(p, e, 1) + mediaFilhos(t, compactoJogar(e, 0));
+            } else if (op == 2) {
+                if (qP >= TAM_PILHA) continue;
+                v = ganhoFixo(p, e, 2) + mediaFilhos(t, compactoReservar(e, 0));
+            } else if (op == 3) {
+                if (qP == 0) continue;
+                v = ganhoFixo(p, e, 3) + mediaFilhos(t, compactoUsarReservada(e, 0));
+            } else {
+                if (qP == 0) continue;
+                EstadoCompacto filho = op == 4 ? compactoTrocar(e) : compactoInverter(e);
+                if (filho == e) continue;             // Não muda nada (ex.: trocar duas iguais)
+                uint64_t f = indiceTabela(filho);
+                v = ganhoFixo(p, e, op) + t->passo[f] + t->desconto * antes[f];
+            }
+            if (v > melhor) { melhor = v; jogada = op; }
+        }
+        float mudanca = melhor > antes[i] ? melhor - antes[i] : antes[i] - melhor;
+        if (mudanca > t->maiorMudanca) t->maiorMudanca = mudanca;
+        t->depois[i] = melhor;
+        unsigned char *byte = &t->decisoes[i >> 1];
+        int desloc = 4 * (int)(i & 1);
+        if (((*byte >> desloc) & 15) != jogada) {
+            t->mudancas++;
+            *byte = (unsigned char)((*byte & ~(15 << desloc)) | (jogada << desloc));
+        }
+    }
+}
+
+static void *rodarTrechoTabela(void *arg) {
+    TrechoTabela *t = arg;
+    EquipeTabela *q = t->equipe;
+    pthread_mutex_lock(&q->portao);               // Espera a principal montar as barreiras
+    pthread_mutex_unlock(&q->portao);
+    for (;;) {
+        pthread_barrier_wait(&q->largada);
+        if (q->parar) return NULL;
+        calcularTrecho(t);
+        pthread_barrier_wait(&q->chegada);
+    }
+}
+
+// Escreve a tabela como um array C (para compilar junto com -DTABELA_EMBUTIDA)
+static int escreverCabecalhoC(const char *caminho, const unsigned char *bytes, size_t tam) {
+    FILE *f = fopen(caminho, "w");
+    if (f == NULL) { fprintf(stderr, "Não foi possível criar '%s'\n", caminho); return 0; }
+    fprintf(f, "/* Tabela de decisão gerada por ./busca --build-table (TAM_FILA %d, TAM_PILHA %d) */\n",
+            TAM_FILA, TAM_PILHA);
+    fprintf(f, "static const unsigned char tabelaEmbutida[%zu] = {\n", tam);
+    for (size_t k = 0; k < tam; k++)
+        fprintf(f, "%u,%s", bytes[k], (k % 32 == 31 || k + 1 == tam) ? "\n" : "");
+    fprintf(f, "};\n");
+    return fclose(f) == 0;
+}
+
+/* ============================================================= */
+/*  Função: gerarTabela()                                        */
+/*  Calcula a tabela de decisão com "qtdThreads" threads e grava */
+/*  em "saida" (e em "saidaC" como array C, se não for NULL)    */
+/* ============================================================= */
+int gerarTabela(const Pontuacao *p, int horizonte, int qtdThreads, const char *saida, const char *saidaC) {
+    uint64_t qtd = qtdEstadosTabela();
+    if (qtd > (1ULL << 31)) { fprintf(stderr, "Estados demais para a tabela: %llu\n", (unsigned long long)qtd); return 0; }
+    size_t bytes = (size_t)((qtd + 1) / 2);
+    float *antes = malloc(qtd * sizeof(float)), *depois = malloc(qtd * sizeof(float));
+    float *passo = malloc(qtd * sizeof(float));
+    unsigned char *arquivo = calloc(sizeof(CabecalhoTabela) + bytes, 1);
+    TrechoTabela *trechos = calloc((size_t)qtdThreads, sizeof(TrechoTabela));
+    pthread_t *threads = calloc((size_t)qtdThreads, sizeof(pthread_t));
+    if (antes == NULL || depois == NULL || passo == NULL || arquivo == NULL || trechos == NULL || threads == NULL) {
+        fprintf(stderr, "Memória insuficiente para a tabela\n");
+        free(antes); free(depois); free(passo); free(arquivo); free(trechos); free(threads);
+        return 0;
+    }
+    unsigned char *decisoes = arquivo + sizeof(CabecalhoTabela);
+    for (uint64_t i = 0; i < qtd; i++) {
+        EstadoCompacto e = estadoDoIndice(i);
+        antes[i] = (float)p->avaliarFolha(e, p->ctx);
+        passo[i] = p->avaliarPasso != NULL ? (float)p->avaliarPasso(e, p->ctx) : 0.0f;
+    }
+
+    // Sobe as threads (a principal é o trecho 0); se alguma não subir,
+    // os estados são divididos só entre as que subiram
+    EquipeTabela equipe = { .parar = 0 };
+    pthread_mutex_init(&equipe.portao, NULL);
+    pthread_mutex_lock(&equipe.portao);
+    int qtdTrechos = 1;
+    for (; qtdTrechos < qtdThreads; qtdTrechos++) {
+        trechos[qtdTrechos].equipe = &equipe;
+        if (pthread_create(&threads[qtdTrechos], NULL, rodarTrechoTabela, &trechos[qtdTrechos]) != 0) {
+            fprintf(stderr, "Não foi possível criar a thread %d: seguindo com %d\n", qtdTrechos, qtdTrechos);
+            break;
+        }
+    }
+    uint64_t porThread = ((qtd + qtdTrechos - 1) / qtdTrechos + 1) & ~1ULL;
+    for (int t = 0; t < qtdTrechos; t++) {
+        trechos[t].pontuacao = p;
+        trechos[t].passo = passo;
+        trechos[t].decisoes = decisoes;
+        trechos[t].desconto = 1.0f - 1.0f / horizonte;
+        trechos[t].inicio = porThread * t < qtd ? porThread * t : qtd;
+        trechos[t].fim = porThread * (t + 1) < qtd ? porThread * (t + 1) : qtd;
+        trechos[t].equipe = &equipe;
+    }
+    pthread_barrier_init(&equipe.largada, NULL, (unsigned)qtdTrechos);
+    pthread_barrier_init(&equipe.chegada, NULL, (unsigned)qtdTrechos);
+    pthread_mutex_unlock(&equipe.portao);
+
+    printf("=== TABELA DE DECISÃO – %llu estados, horizonte %d, %d threads ===\n",
+           (unsigned long long)qtd, horizonte, qtdTrechos);
+    long long t0 = agoraNs();
+    float maiorMudanca = 0;
+    int volta;
+    for (volta = 1; volta <= MAX_VOLTAS_TABELA; volta++) {
+        for (int t = 0; t < qtdTrechos; t++) {
+            trechos[t].antes = antes;
+            trechos[t].depois = depois;
+        }
+        pthread_barrier_wait(&equipe.largada);
+        calcularTrecho(&trechos[0]);
+        pthread_barrier_wait(&equipe.chegada);
+        maiorMudanca = 0;
+        uint64_t mudancas = 0;
+        for (int t = 0; t < qtdTrechos; t++) {
+            if (trechos[t].maiorMudanca > maiorMudanca) maiorMudanca = trechos[t].maiorMudanca;
+            mudancas += trechos[t].mudancas;
+        }
+        float *troca = antes; antes = depois; depois = troca;
+        if (volta % 25 == 0) printf("  volta %4d: mudança máxima %.6f, %llu decisões mudaram\n",
+                                    volta, maiorMudanca, (unsigned long long)mudancas);
+        if (maiorMudanca < TOLERANCIA_TABELA) break;
+    }
+    equipe.parar = 1;                             // Solta as threads da largada para saírem
+    pthread_barrier_wait(&equipe.largada);
+    for (int t = 1; t < qtdTrechos; t++) pthread_join(threads[t], NULL);
+    pthread_barrier_destroy(&equipe.largada);
+    pthread_barrier_destroy(&equipe.chegada);
+    pthread_mutex_destroy(&equipe.portao);
+    long long duracao = agoraNs() - t0;
+
+    unsigned long long usos[16] = {0};
+    double soma = 0;
+    for (uint64_t i = 0; i < qtd; i++) { usos[decisaoNoIndice(decisoes, i)]++; soma += antes[i]; }
+    printf("Voltas   : %d em %.2f s (mudança final %.6f)\n", volta > MAX_VOLTAS_TABELA ? MAX_VOLTAS_TABELA : volta,
+           duracao / 1e9, maiorMudanca);
+    printf("Decisões : jogar %llu, reservar %llu, usar %llu, trocar %llu, inverter %llu\n",
+           usos[1], usos[2], usos[3], usos[4], usos[6]);
+    printf("Valor    : média %.3f por estado\n", soma / qtd);
+
+    montarCabecalhoTabela((CabecalhoTabela *)arquivo, decisoes, horizonte);
+    size_t tamArquivo = sizeof(CabecalhoTabela) + bytes;
+    int ok = 1;
+    FILE *f = fopen(saida, "wb");
+    if (f == NULL || fwrite(arquivo, 1, tamArquivo, f) != tamArquivo) ok = 0;
+    if (f != NULL && fclose(f) != 0) ok = 0;
+    if (!ok) fprintf(stderr, "Não foi possível gravar '%s'\n", saida);
+    else printf("Gravada  : %s (%zu bytes)\n", saida, tamArquivo);
+    if (ok && saidaC != NULL && (ok = escreverCabecalhoC(saidaC, arquivo, tamArquivo))) printf("Array C  : %s\n", saidaC);
+
+    free(antes); free(depois); free(passo); free(arquivo); free(trechos); free(threads);
+    return ok;
+}
+
+#ifdef TABELA_EMBUTIDA
+#include TABELA_EMBUTIDA                      // make busca CFLAGS+='-DTABELA_EMBUTIDA="tabela.h"'
+#endif
+
+/* ============================================================= */
+/*  Função: abrirTabela()                                        */
+/*  Lê a tabela com mmap ("builtin" = o array compilado junto)  */
+/*  e confere o cabeçalho e a soma. Devolve 0 se não deu.       */
+/* ============================================================= */
+int abrirTabela(TabelaDecisao *t, const char *caminho) {
+#ifdef TABELA_EMBUTIDA
+    if (strcmp(caminho, "builtin") == 0) {
+        int r = usarTabela(t, tabelaEmbutida, sizeof tabelaEmbutida);
+        if (r != SNAPSHOT_OK) { fprintf(stderr, "Tabela embutida: %s\n", mensagensSnapshot[r]); return 0; }
+        return 1;
+    }
+#endif
+    int fd = open(caminho, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Não foi possível abrir '%s'\n", caminho);
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    size_t tamArquivo = (size_t)info.st_size;
+    const unsigned char *mapa = tamArquivo > 0 ? mmap(NULL, tamArquivo, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);                                  // O mapeamento continua valendo
+    if (mapa == MAP_FAILED) { fprintf(stderr, "mmap falhou em '%s'\n", caminho); return 0; }
+    int r = usarTabela(t, mapa, tamArquivo);
+    if (r != SNAPSHOT_OK) {
+        fprintf(stderr, "'%s': %s\n", caminho, mensagensSnapshot[r]);
+        munmap((void *)mapa, tamArquivo);
+        return 0;
+    }
+    return 1;                                   // O mapa fica até o fim do programa
+}
+
+/* ============================================================= */
+/*  main() da busca: joga uma partida decidindo com a busca e   */
+/*  compara com "sempre jogar"                                   */
+/* ============================================================= */
+static int compararLL(const void *a, const void *b) {
+    long long x = *(const long long *)a, y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+int main(int argc, char *argv[]) {
+    uint64_t semente = 12345;
+    int profundidade = 6, bitsTabela = 20, modo = MODO_ALEATORIO;
+    long jogadas = 10000;
+    long long limiteUs = 0;
+    const char *gerar = NULL, *gerarC = NULL, *arquivoTabela = NULL;
+    int horizonte = 12, qtdThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--depth") == 0 && a + 1 < argc) profundidade = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--moves") == 0 && a + 1 < argc) jogadas = atol(argv[++a]);
+        else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) semente = strtoull(argv[++a], NULL, 10);
+        else if (strcmp(argv[a], "--tt-bits") == 0 && a + 1 < argc) bitsTabela = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--time-us") == 0 && a + 1 < argc) limiteUs = atoll(argv[++a]);
+        else if (strcmp(argv[a], "--build-table") == 0 && a + 1 < argc) gerar = argv[++a];
+        else if (strcmp(argv[a], "--c-header") == 0 && a + 1 < argc) gerarC = argv[++a];
+        else if (strcmp(argv[a], "--horizon") == 0 && a + 1 < argc) horizonte = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) qtdThreads = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--table") == 0 && a + 1 < argc) arquivoTabela = argv[++a];
+        else if (strcmp(argv[a], "--generator") == 0 && a + 1 < argc) {
+            a++;
+            if (strcmp(argv[a], "bag") == 0) modo = MODO_SACO;
+            else if (strcmp(argv[a], "random") == 0) modo = MODO_ALEATORIO;
+            else { fprintf(stderr, "Gerador desconhecido: %s (use bag ou random)\n", argv[a]); return 1; }
+        } else {
+            fprintf(stderr, "Uso: %s [--depth N] [--moves N] [--seed N] [--tt-bits N] [--time-us N]"
+                            " [--generator bag|random] [--table arquivo.tdt]\n"
+                            "       %s --build-table arquivo.tdt [--horizon N] [--threads N] [--c-header arquivo.h]\n",
+                    argv[0], argv[0]);
+            return 1;
+        }
+    }
+    if (profundidade < 1) profundidade = 1;
+    if (bitsTabela < 1) bitsTabela = 1;           // 2^30 entradas (16 GB) já é mais que o bastante
+    if (bitsTabela > 30) bitsTabela = 30;
+    if (jogadas < 1) jogadas = 1;
+    if (horizonte < 2) horizonte = 2;
+    if (horizonte > 65535) horizonte = 65535;
+    if (qtdThreads < 1) qtdThreads = 1;
+    if (gerar != NULL) return gerarTabela(&pontuacaoPadrao, horizonte, qtdThreads, gerar, gerarC) ? 0 : 1;
+
+    TabelaDecisao tabela;
+    if (arquivoTabela != NULL && !abrirTabela(&tabela, arquivoTabela)) return 1;
+
+    Busca *busca = malloc(sizeof(Busca));
+    long long *tempos = malloc((size_t)jogadas * sizeof(long long));
+    if (busca == NULL || tempos == NULL || !iniciarBusca(busca, bitsTabela, &pontuacaoPadrao)) {
+        fprintf(stderr, "Memória insuficiente\n");
+        return 1;
+    }
+
+    modoSilencioso = 1;
+    GeradorPecas g;
+    iniciarGerador(&g, semente, modo);
+    static Jogo jogo, base;
+    iniciarJogo(&jogo, &g);
+    iniciarJogo(&base, &g);                       // Mesmas peças, sempre jogando a da frente
+
+    long long pontos = 0, pontosBase = 0, somaProf = 0;
+    long usos[8] = {0};
+    for (long n = 0; n < jogadas; n++) {
+        int prof;
+        long long t0 = agoraNs();
+        int op;
+        if (arquivoTabela != NULL) {
+            op = consultarTabela(&tabela, compactar(&jogo));   // Um acesso à memória no lugar da busca
+            if (op == 0) op = 1;
+            prof = 0;
+        } else {
+            op = decidirJogada(busca, &jogo, profundidade, limiteUs * 1000, &prof);
+        }
+        tempos[n] = agoraNs() - t0;
+        somaProf += prof;
+
+        EstadoCompacto antes = compactar(&jogo);
+        if (executarAcao(&jogo, op) == RESULTADO_OK) {
+            usos[op]++;
+            pontos += ganhoDaJogada(&pontuacaoPadrao, antes, op, compactar(&jogo));
+        }
+        EstadoCompacto antesBase = compactar(&base);
+        executarAcao(&base, 1);
+        pontosBase += ganhoDaJogada(&pontuacaoPadrao, antesBase, 1, compactar(&base));
+    }
+
+    qsort(tempos, (size_t)jogadas, sizeof tempos[0], compararLL);
+    long long soma = 0;
+    for (long n = 0; n < jogadas; n++) soma += tempos[n];
+
+    if (arquivoTabela != NULL)
+        printf("=== BUSCA – tabela de decisão (horizonte %d), %ld jogadas ===\n", tabela.horizonte, jogadas);
+    else
+        printf("=== BUSCA – profundidade %d, %ld jogadas, tabela 2^%d ===\n", profundidade, jogadas, bitsTabela);
+    printf("Jogadas  : jogar %ld, reservar %ld, usar %ld, trocar %ld, inverter %ld\n",
+           usos[1], usos[2], usos[3], usos[4], usos[6]);
+    printf("Pontos   : %lld (sempre jogar: %lld)\n", pontos, pontosBase);
+    if (arquivoTabela != NULL)
+        printf("Tabela   : %llu estados, uma consulta por jogada\n", (unsigned long long)tabela.qtdEstados);
+    else
+        printf("Nós      : %llu (%.1f%% resolvidos pela tabela)\n", busca->nos,
+               busca->nos ? 100.0 * busca->acertosTT / busca->nos : 0.0);
+    printf("Decisão  : média %.1f µs, p50 %.1f µs, p99 %.1f µs",
+           soma / 1e3 / jogadas, tempos[jogadas / 2] / 1e3, tempos[jogadas * 99 / 100] / 1e3);
+    if (arquivoTabela == NULL) printf(" (profundidade média %.1f)", (double)somaProf / jogadas);
+    printf("\n");
+
+    liberarJogo(&jogo);
+    liberarJogo(&base);
+    liberarBusca(busca);
+    free(busca);
+    free(tempos);
+    return 0;
+}
@@ -1,298 +1,1265 @@
-/* ============================================================= */
-/*  TETRIS STACK – NÍVEL MESTRE                                 */
-/* ============================================================= */
-
-#include <stdio.h>      // Biblioteca para usar printf, scanf, etc. (entrada/saída no terminal)
-#include <stdlib.h>     // Biblioteca para usar malloc, free, exit, rand, srand
-#include <time.h>       // Biblioteca para usar time() → faz o jogo ter peças diferentes a cada vez que roda
-
-/* ------------------- DEFINIÇÃO DO TIPO "PEÇA" ---------------- */
-// Crio um "molde" chamado Peca que representa uma peça do Tetris
-typedef struct {
-    char nome;   // Guarda a letra da peça: 'I', 'O', 'T', 'L', 'J', 'S' ou 'Z'
-    int  id;     // Número único que cada peça recebe quando é criada (ex: 0, 1, 2...)
-} Peca;          // Agora posso criar variáveis do tipo Peca em qualquer lugar
-
-/* ------------------- CONFIGURAÇÕES DA FILA (Next Queue) ------ */
-#define TAM_FILA 5                    // A fila sempre tem exatamente 5 posições
-Peca fila[TAM_FILA];                  // Array que guarda as próximas 5 peças
-int frente = 0;                       // Índice da peça que vai cair AGORA (primeira da fila)
-int tras   = 0;                       // Índice onde será colocada a próxima peça nova
-int qtdFila = 0;                      // Quantas peças estão na fila no momento (começa com 0)
-
-/* ------------------- CONFIGURAÇÕES DA PILHA (Hold) ---------- */
-#define TAM_PILHA 3                   // A reserva (Hold) aceita no máximo 3 peças
-Peca pilha[TAM_PILHA];                // Array que guarda as peças reservadas
-int topo = -1;                        // -1 significa pilha vazia. Quando tem peça, vira 0, 1 ou 2
-int qtdPilha = 0;                     // Quantas peças estão reservadas agora
-
-/* ------------------- HISTÓRICO PARA O "DESFAZER" (UNDO) ----- */
-// Estrutura que guarda um "backup" completo do jogo em um momento
-typedef struct {
-    Peca fila_salva[TAM_FILA];        // Cópia completa da fila
-    int frente_salvo, tras_salvo, qtdFila_salvo;  // Cópia dos índices e quantidade
-    Peca pilha_salva[TAM_PILHA];      // Cópia completa da pilha
-    int topo_salvo, qtdPilha_salvo;   // Cópia do topo e quantidade da pilha
-} Estado;                             // Um "Estado" é uma foto do jogo inteiro
-
-Estado historico[100];                // Array que guarda até 100 "fotos" do jogo
-int qtdHistorico = 0;                 // Quantas fotos já foram tiradas (começa com 0)
-
-/* ------------------- GERADOR DE PEÇAS ----------------------- */
-int proximoId = 0;                    // Contador que dá ID único para cada peça
-const char tiposPeca[7] = {'I', 'O', 'T', 'L', 'J', 'S', 'Z'}; // As .length7 peças do Tetris
-
-/* ============================================================= */
-/*  Função: gerarPeca()                                          */
-/*  Cria uma peça nova com letra aleatória e ID único           */
-/* ============================================================= */
-Peca gerarPeca() {
-    Peca p;                           // Crio uma peça temporária
-    p.nome = tiposPeca[rand() % 7];   // rand() % 7 dá número de 0 a 6 → escolhe uma letra aleatória
-    p.id   = proximoId++;             // Uso o próximo ID disponível e já aumento o contador
-    return p;                         // Devolvo a peça pronta
-}
-
-/* ============================================================= */
-/*  Função: salvarEstado()                                       */
-/*  Tira uma "foto" do jogo inteiro e guarda no histórico      */
-/* ============================================================= */
-void salvarEstado() {
-    if (qtdHistorico >= 100) return;  // Proteção (nunca vai acontecer)
-
-    // Salva a fila inteira
-    for (int i = 0; i < TAM_FILA; i++) 
-        historico[qtdHistorico].fila_salva[i] = fila[i];
-    
-    // Salva os índices e quantidade da fila
-    historico[qtdHistorico].frente_salvo = frente;
-    historico[qtdHistorico].tras_salvo   = tras;
-    historico[qtdHistorico].qtdFila_salvo = qtdFila;
-
-    // Salva a pilha inteira
-    for (int i = 0; i < TAM_PILHA; i++) 
-        historico[qtdHistorico].pilha_salva[i] = pilha[i];
-    
-    // Salva os índices e quantidade da pilha
-    historico[qtdHistorico].topo_salvo    = topo;
-    historico[qtdHistorico].qtdPilha_salvo = qtdPilha;
-
-    qtdHistorico++;                   // Aumenta o contador de fotos tiradas
-}
-
-/* ============================================================= */
-/*  Função: desfazer()                                           */
-/*  Volta para o estado anterior (UNDO)                          */
-/* ============================================================= */
-void desfazer() {
-    if (qtdHistorico == 0) {          // Se não tem nenhuma foto para voltar
-        printf("  Nada para desfazer!\n");
-        return;
-    }
-    qtdHistorico--;                   // Volta uma foto no histórico
-
-    // Restaura a fila
-    for (int i = 0; i < TAM_FILA; i++) 
-        fila[i] = historico[qtdHistorico].fila_salva[i];
-    frente  = historico[qtdHistorico].frente_salvo;
-    tras    = historico[qtdHistorico].tras_salvo;
-    qtdFila = historico[qtdHistorico].qtdFila_salvo;
-
-    // Restaura a pilha
-    for (int i = 0; i < TAM_PILHA; i++) 
-        pilha[i] = historico[qtdHistorico].pilha_salva[i];
-    topo    = historico[qtdHistorico].topo_salvo;
-    qtdPilha = historico[qtdHistorico].qtdPilha_salvo;
-
-    printf("  Última ação desfeita!\n");
-}
-
-/* ============================================================= */
-/*  Função: enqueue()                                            */
-/*  Adiciona uma peça nova no final da fila (circular)          */
-/* ============================================================= */
-void enqueue() {
-    if (qtdFila < TAM_FILA) {         // Só adiciona se tiver espaço
-        Peca nova = gerarPeca();      // Cria peça nova
-        fila[tras] = nova;            // Coloca na posição "tras"
-        tras = (tras + 1) % TAM_FILA; // Avança circularmente (ex: 4+1 → 0)
-        qtdFila++;                    // Aumenta quantidade
-    }
-}
-
-/* ============================================================= */
-/*  Função: dequeue()                                            */
-/*  Remove e devolve a peça da frente da fila                   */
-/* ============================================================= */
-Peca dequeue() {
-    Peca p = fila[frente];            // Pega a peça da frente
-    frente = (frente + 1) % TAM_FILA; // Avança o ponteiro da frente
-    qtdFila--;                        // Diminui quantidade
-    return p;                         // Devolve a peça removida
-}
-
-/* ============================================================= */
-/*  Opção 1 – Jogar peça normal                                  */
-/* ============================================================= */
-void jogarPeca() {
-    salvarEstado();                   // Guarda o estado antes de jogar
-    if (qtdFila == 0) { printf("  Fila vazia!\n"); return; }
-    Peca jogada = dequeue();          // Remove da frente
-    printf("  Jogou peça [%c %d]\n", jogada.nome, jogada.id);
-    enqueue();                        // Gera nova peça → fila volta a ter 5
-}
-
-/* ============================================================= */
-/*  Opção 2 – Reservar peça (Hold)                               */
-/* ============================================================= */
-void reservarPeca() {
-    salvarEstado();
-    if (qtdFila == 0) { printf("  Fila vazia!\n"); return; }
-    if (qtdPilha >= TAM_PILHA) { printf("  Reserva cheia!\n"); return; }
-
-    Peca p = dequeue();               // Tira da frente da fila
-    topo++; pilha[topo] = p; qtdPilha++;  // Empilha
-    printf("  Reservou [%c %d]\n", p.nome, p.id);
-    enqueue();                        // Repõe na fila
-}
-
-/* ============================================================= */
-/*  Opção 3 – Usar peça reservada                                */
-/* ============================================================= */
-void usarReservada() {
-    salvarEstado();
-    if (qtdPilha == 0) { printf("  Reserva vazia!\n"); return; }
-
-    Peca usada = pilha[topo]; topo--; qtdPilha--;  // Desempilha
-    printf("  Usou reservada [%c %d]\n", usada.nome, usada.id);
-
-    Peca jogada = dequeue();          // Joga a peça que estava na frente
-    printf("  Jogou da fila [%c %d]\n", jogada.nome, jogada.id);
-    enqueue();
-}
-
-/* ============================================================= */
-/*  Opção 4 – Trocar topo da pilha com frente da fila           */
-/* ============================================================= */
-void trocarTopoComFrente() {
-    salvarEstado();
-    if (qtdFila == 0 || qtdPilha == 0) {
-        printf("  Não é possível trocar: uma das estruturas está vazia!\n");
-        return;
-    }
-    Peca temp = pilha[topo];          // Guarda temporariamente a peça do topo
-    pilha[topo] = fila[frente];       // Topo recebe peça da frente
-    fila[frente] = temp;              // Frente recebe peça do topo
-    printf("  Trocou topo da pilha com frente da fila!\n");
-}
-
-/* ============================================================= */
-/*  Opção 6 – Inverter fila com pilha (SWAP TOTAL)              */
-/* ============================================================= */
-void inverterFilaComPilha() {
-    salvarEstado();
-
-    // Variáveis temporárias para guardar tudo
-    Peca tempFila[TAM_FILA];
-    int tempFrente = frente, tempTras = tras, tempQtdF = qtdFila;
-    Peca tempPilha[TAM_PILHA];
-    int tempTopo = topo, tempQtdP = qtdPilha;
-
-    // Copia fila para temp
-    for (int i = 0; i < TAM_FILA; i++) tempFila[i] = fila[i];
-    // Copia pilha para fila (as peças da pilha viram as primeiras da fila)
-    for (int i = 0; i < qtdPilha && i < TAM_FILA; i++) fila[i] = pilha[i];
-    // Completa o resto da fila com as antigas peças
-    for (int i = qtdPilha; i < TAM_FILA; i++) fila[i] = tempFila[i - qtdPilha];
-
-    frente = 0; tras = qtdPilha; qtdFila = qtdPilha;  // Atualiza índices
-
-    // Copia antigas peças da fila para a pilha
-    for (int i = 0; i < tempQtdF && i < TAM_PILHA; i++) pilha[i] = tempFila[i];
-    topo = (tempQtdF < TAM_PILHA ? tempQtdF - 1 : TAM_PILHA - 1);
-    qtdPilha = (tempQtdF < TAM_PILHA ? tempQtdF : TAM_PILHA);
-
-    printf("  Inverteu fila com pilha! (SWAP TOTAL)\n");
-}
-
-/* ============================================================= */
-/*  Funções de exibição                                          */
-/* ============================================================= */
-void exibirFila() {
-    printf("Fila     : ");
-    if (qtdFila == 0) printf("<vazia>\n");
-    else {
-        int i = frente;
-        for (int c = 0; c < qtdFila; c++) {
-            printf("[%c %d] ", fila[i].nome, fila[i].id);
-            i = (i + 1) % TAM_FILA;
-        }
-        printf("\n");
-    }
-}
-
-void exibirPilha() {
-    printf("Reserva  : ");
-    if (qtdPilha == 0) printf("<vazia>\n");
-    else {
-        for (int i = topo; i >= 0; i--) {
-            printf("[%c %d] ", pilha[i].nome, pilha[i].id);
-        }
-        printf(" ← topo\n");
-    }
-}
-
-void exibirMenu() {
-    printf("╔══════════════════════════════════════════╗\n");
-    exibirFila();
-    exibirPilha();
-    printf("╠──────────────────────────────────────────╣\n");
-    printf("║ 1 - Jogar peça atual                     ║\n");
-    printf("║ 2 - Reservar peça (Hold)                 ║\n");
-    printf("║ 3 - Usar peça reservada                  ║\n");
-    printf("║ 4 - Trocar topo com frente               ║\n");
-    printf("║ 5 - Desfazer última ação                 ║\n");
-    printf("║ 6 - Inverter fila com pilha (SWAP)       ║\n");
-    printf("║ 0 - Sair                                 ║\n");
-    printf("╚══════════════════════════════════════════╝\n");
-    printf("→ ");
-}
-
-/* ============================================================= */
-/*  Inicialização do jogo                                        */
-/* ============================================================= */
-void inicializar() {
-    printf("=== TETRIS STACK – NÍVEL MESTRE ===\n");
-    printf("Gerando 5 peças iniciais...\n");
-    while (qtdFila < TAM_FILA) enqueue();  // Preenche a fila
-    salvarEstado();                        // Salva estado inicial
-    printf("\n");
-}
-
-/* ============================================================= */
-/*  Função principal – onde o programa começa                   */
-/* ============================================================= */
-int main() {
-    srand(time(NULL));      // Faz o rand() gerar números diferentes a cada execução
-    inicializar();          // Prepara o jogo
-
-    int op;                 // Variável que guarda a opção do jogador
-    do {                    // Repete até digitar 0
-        exibirMenu();       // Mostra o estado atual + opções
-        scanf("%d", &op);   // Lê a escolha
-
-        switch (op) {       // Executa a função certa
-            case 1: jogarPeca();          break;
-            case 2: reservarPeca();       break;
-            case 3: usarReservada();      break;
-            case 4: trocarTopoComFrente(); break;
-            case 5: desfazer();           break;
-            case 6: inverterFilaComPilha(); break;
-            case 0: printf("Obrigado por jogar, Mestre do Tetris!\n"); break;
-            default: printf("Opção inválida!\n");
-        }
-        printf("\n");
-    } while (op != 0);      // Sai do loop quando digitar 0
-
-    return 0;               // Termina o programa com sucesso
-}
\ No newline at end of file
+/* ============================================================= */
+/*  TETRIS STACK – NÍVEL MESTRE                                 */
+/* ============================================================= */
+/*  O motor do jogo mora na biblioteca (tetrisstack.h/.c). Aqui */
+/*  fica só o que é deste programa: a tela, o menu, o modo      */
+/*  batch, o replay e a linha de comando.                       */
+/*                                                               */
+/*    make mestre   (ou: gcc -O2 -pthread                       */
+/*                   TetrisStack_Nivel_Mestre_Marlus.c tetrisstack.c -lm) */
+/* ============================================================= */
+
+#define _GNU_SOURCE     // timerfd, prctl(PR_SET_TIMERSLACK), sched_setscheduler
+#include <stdio.h>      // Biblioteca para usar printf, fprintf (saída no terminal)
+#include <stdlib.h>     // Biblioteca para usar malloc, free, exit
+#include <stdint.h>     // Biblioteca para usar uint64_t (semente do gerador de peças)
+#include <time.h>       // Biblioteca para usar time() → faz o jogo ter peças diferentes a cada vez que roda
+#include <string.h>     // Biblioteca para usar strcmp (comparar os argumentos da linha de comando)
+#include <unistd.h>     // Biblioteca para usar write e isatty (desenhar a tela de uma vez só)
+#include <fcntl.h>      // Biblioteca para usar open (abrir a gravação para o replay)
+#include <sys/mman.h>   // Biblioteca para usar mmap (ler a gravação direto da memória)
+#include <sys/stat.h>   // Biblioteca para usar fstat (tamanho do arquivo)
+#include <poll.h>       // Biblioteca para usar poll (esperar teclado e relógio juntos)
+#include <termios.h>    // Biblioteca para usar tcsetattr (teclado sem Enter no --realtime)
+#include <signal.h>     // Biblioteca para usar sigaction (Ctrl+C devolve o terminal arrumado)
+#include <sched.h>      // Biblioteca para usar sched_setscheduler (--rt-priority)
+#include <sys/timerfd.h>   // Biblioteca para usar timerfd (o tique fixo da simulação)
+#include <sys/prctl.h>  // Biblioteca para usar prctl (folga do timer de 50 µs → 1 µs)
+#include "tetrisstack.h"   // O motor do jogo (libtetrisstack)
+
+/* ============================================================= */
+/*  TELA: quadro montado num buffer e enviado só com o que mudou */
+/* ============================================================= */
+// Em vez de dezenas de printf por menu (cada um passando pelo lock do
+// stdio), a tela inteira é montada em quadroAtual, comparada linha a
+// linha com o quadro anterior, e só as linhas diferentes vão para o
+// terminal: um comando ANSI "vai para a linha L" + o texto novo + "apaga
+// o resto da linha". Tudo num único write(). Numa conexão SSH lenta,
+// jogar uma peça manda 3 linhas em vez do menu inteiro.
+//
+// Se a saída não for um terminal (redirecionada para arquivo, pipe...),
+// o quadro sai inteiro, sem códigos ANSI.
+#define LINHA_FILA    1
+#define LINHA_PILHA   2
+#define LINHA_STATUS 13
+#define LINHA_PROMPT 14
+#define LINHAS_TELA  15
+
+const char *linhasFixas[LINHAS_TELA] = {
+    "╔══════════════════════════════════════════╗",
+    NULL,                                         // Fila (muda a cada jogada)
+    NULL,                                         // Reserva
+    "╠──────────────────────────────────────────╣",
+    "║ 1 - Jogar peça atual                     ║",
+    "║ 2 - Reservar peça (Hold)                 ║",
+    "║ 3 - Usar peça reservada                  ║",
+    "║ 4 - Trocar topo com frente               ║",
+    "║ 5 - Desfazer última ação                 ║",
+    "║ 6 - Inverter fila com pilha (SWAP)       ║",
+    "║ 7 - Refazer ação desfeita                ║",
+    "║ 0 - Sair                                 ║",
+    "╚══════════════════════════════════════════╝",
+    NULL,                                         // Linha de status (mensagens)
+    "→ ",
+};
+
+char quadros[2][LINHAS_TELA][COLUNAS_TELA];      // Quadro atual e anterior (trocam de papel)
+int quadroAtual = 0;                              // Qual dos dois é o atual
+int primeiroQuadro = 1;                           // O primeiro quadro limpa a tela e vai inteiro
+int telaAnsi = 0;                                 // 1 = terminal de verdade (pode usar ANSI)
+char saidaTela[LINHAS_TELA * (COLUNAS_TELA + 16) + 32];   // Tudo que vai no write()
+char linhaPrompt[COLUNAS_TELA] = "";             // No --realtime, a queda da peça no lugar do "→ "
+
+static size_t anexar(size_t n, const char *texto) {
+    size_t tam = strlen(texto);
+    if (n + tam > sizeof saidaTela) tam = sizeof saidaTela - n;
+    memcpy(saidaTela + n, texto, tam);
+    return n + tam;
+}
+
+/* ============================================================= */
+/*  Função: renderizar()                                         */
+/*  Monta o quadro do jogo e manda para o terminal só o que     */
+/*  mudou desde o quadro anterior                               */
+/* ============================================================= */
+void renderizar(const Jogo *j) {
+    char (*atual)[COLUNAS_TELA] = quadros[quadroAtual];
+    char (*anterior)[COLUNAS_TELA] = quadros[!quadroAtual];
+
+    for (int l = 0; l < LINHAS_TELA; l++)
+        if (linhasFixas[l] != NULL) snprintf(atual[l], COLUNAS_TELA, "%s", linhasFixas[l]);
+    formatarFila(j, atual[LINHA_FILA], COLUNAS_TELA);
+    formatarPilha(j, atual[LINHA_PILHA], COLUNAS_TELA);
+    snprintf(atual[LINHA_STATUS], COLUNAS_TELA, "%s", linhaStatus);
+    if (linhaPrompt[0] != '\0') snprintf(atual[LINHA_PROMPT], COLUNAS_TELA, "%s", linhaPrompt);
+
+    size_t n = 0;
+    char cmd[32];
+    if (!telaAnsi) {                              // Sem terminal: quadro inteiro, texto puro
+        if (!primeiroQuadro) n = anexar(n, "\n");   // Termina a linha do prompt anterior
+        for (int l = 0; l < LINHAS_TELA; l++) {
+            n = anexar(n, atual[l]);
+            if (l != LINHA_PROMPT) n = anexar(n, "\n");
+        }
+    } else {
+        if (primeiroQuadro) n = anexar(n, "\x1b[H\x1b[2J");   // Cursor no início + limpa a tela
+        for (int l = 0; l < LINHAS_TELA; l++) {
+            // O prompt sempre é redesenhado: o que o jogador digitou está nele
+            if (!primeiroQuadro && l != LINHA_PROMPT && strcmp(atual[l], anterior[l]) == 0) continue;
+            snprintf(cmd, sizeof cmd, "\x1b[%d;1H", l + 1);   // Vai para a linha l (ANSI conta a partir de 1)
+            n = anexar(n, cmd);
+            n = anexar(n, atual[l]);
+            n = anexar(n, "\x1b[K");                         // Apaga o resto da linha antiga
+        }
+        snprintf(cmd, sizeof cmd, "\x1b[%d;1H\x1b[K", LINHA_PROMPT + 2);   // Linha onde o Enter deixou o cursor
+        n = anexar(n, cmd);
+        snprintf(cmd, sizeof cmd, "\x1b[%d;3H", LINHA_PROMPT + 1);          // Cursor logo depois do "→ "
+        n = anexar(n, cmd);
+    }
+
+    fflush(stdout);                               // O que o printf tiver guardado sai antes
+    for (size_t enviado = 0; enviado < n; ) {     // Um write() (repete só se o terminal aceitar menos)
+        ssize_t w = write(STDOUT_FILENO, saidaTela + enviado, n - enviado);
+        if (w <= 0) break;
+        enviado += (size_t)w;
+    }
+    primeiroQuadro = 0;
+    quadroAtual = !quadroAtual;                   // O atual vira o anterior do próximo quadro
+}
+
+/* ============================================================= */
+/*  Inicialização do jogo (com as mensagens do modo interativo) */
+/* ============================================================= */
+void inicializar(Jogo *j, uint64_t semente, int modo) {
+    MSG("=== TETRIS STACK – NÍVEL MESTRE ===\n");
+    MSG("Gerando %d peças iniciais...\n", TAM_FILA);
+    GeradorPecas g;
+    iniciarGerador(&g, semente, modo);
+    iniciarJogo(j, &g);
+}
+
+/* ============================================================= */
+/*  Função: executarReplay()                                     */
+/*  Abre uma gravação com mmap e mostra o jogo no passo pedido  */
+/*  (passo < 0 = no fim da partida)                             */
+/* ============================================================= */
+int executarReplay(const char *caminho, long long passoAlvo) {
+    int fd = open(caminho, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Não foi possível abrir '%s'\n", caminho);
+        if (fd >= 0) close(fd);
+        return 1;
+    }
+    size_t tamArquivo = (size_t)info.st_size;
+    if (tamArquivo < sizeof(CabecalhoGravacao) + sizeof(RodapeGravacao)) {
+        fprintf(stderr, "'%s' não é uma gravação (pequeno demais)\n", caminho);
+        close(fd);
+        return 1;
+    }
+    const unsigned char *mapa = mmap(NULL, tamArquivo, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);                                  // O mapeamento continua valendo
+    if (mapa == MAP_FAILED) { fprintf(stderr, "mmap falhou em '%s'\n", caminho); return 1; }
+
+    CabecalhoGravacao c;
+    RodapeGravacao r;
+    memcpy(&c, mapa, sizeof c);
+    memcpy(&r, mapa + tamArquivo - sizeof r, sizeof r);
+    const char *problema = NULL;
+    if (memcmp(c.magica, "TSRP", 4) != 0) problema = "não é uma gravação";
+    else if (c.ordemBytes != MARCA_ORDEM_BYTES) problema = "gravado numa máquina com outra ordem de bytes";
+    else if (c.versao != VERSAO_GRAVACAO) problema = "versão de arquivo desconhecida";
+    else if (c.tamFila != TAM_FILA || c.tamPilha != TAM_PILHA)
+        problema = "gravado com outro TAM_FILA/TAM_PILHA";
+    else if (memcmp(r.magica, "TSRI", 4) != 0) problema = "gravação incompleta (sem índice)";
+    else if (r.qtdKeyframes > (tamArquivo - sizeof r) / 16 || r.posicaoIndice < sizeof c
+             || r.posicaoIndice != tamArquivo - sizeof r - r.qtdKeyframes * 16
+             || (r.qtdKeyframes == 0) != (r.totalPassos == 0)) problema = "índice corrompido";
+    else {
+        // Cada entrada do índice: passo crescente (o primeiro é 0), bloco
+        // depois do anterior e antes do índice (com espaço ao menos para o
+        // tamanho do keyframe). Nada é lido do arquivo sem isso.
+        const unsigned char *indice = mapa + r.posicaoIndice;
+        uint64_t passoAnterior = 0, fimAnterior = sizeof c;
+        for (uint64_t k = 0; k < r.qtdKeyframes && problema == NULL; k++) {
+            uint64_t passoK, posK;
+            memcpy(&passoK, indice + 16 * k, 8);
+            memcpy(&posK, indice + 16 * k + 8, 8);
+            if ((k == 0 ? passoK != 0 : passoK <= passoAnterior) || passoK >= r.totalPassos
+                || posK < fimAnterior || posK > r.posicaoIndice - 4) problema = "índice corrompido";
+            passoAnterior = passoK;
+            fimAnterior = posK + 4;
+        }
+    }
+    if (problema != NULL) {
+        fprintf(stderr, "'%s': %s\n", caminho, problema);
+        munmap((void *)mapa, tamArquivo);
+        return 1;
+    }
+
+    uint64_t alvo = (passoAlvo < 0 || (uint64_t)passoAlvo > r.totalPassos) ? r.totalPassos : (uint64_t)passoAlvo;
+    static Jogo jogo;
+    unsigned long long refeitas = 0;
+    if (r.qtdKeyframes == 0) {                  // Partida sem nenhuma ação: só o estado inicial
+        GeradorPecas g;
+        iniciarGerador(&g, c.semente, c.modo);
+        iniciarJogo(&jogo, &g);
+        jogo.historico.orcamento = c.orcamento;
+    } else {
+        // Busca binária: último keyframe com passo <= alvo
+        const unsigned char *indice = mapa + r.posicaoIndice;
+        size_t lo = 0, hi = r.qtdKeyframes;     // Resposta em [lo, hi)
+        while (hi - lo > 1) {
+            size_t meio = lo + (hi - lo) / 2;
+            uint64_t passoMeio;
+            memcpy(&passoMeio, indice + 16 * meio, 8);
+            if (passoMeio <= alvo) lo = meio; else hi = meio;
+        }
+        uint64_t posBloco, proximoPasso = r.totalPassos;
+        memcpy(&posBloco, indice + 16 * lo + 8, 8);
+        if (lo + 1 < r.qtdKeyframes) memcpy(&proximoPasso, indice + 16 * (lo + 1), 8);
+
+        // O bloco vai até o próximo (ou até o índice): keyframe e ações
+        // precisam caber nele
+        uint64_t fimBloco = r.posicaoIndice;
+        if (lo + 1 < r.qtdKeyframes) memcpy(&fimBloco, indice + 16 * (lo + 1) + 8, 8);
+        const unsigned char *bloco = mapa + posBloco;
+        size_t tamBloco = (size_t)(fimBloco - posBloco);
+        long long passo = restaurarKeyframe(&jogo, bloco, tamBloco);
+        uint64_t passoIndice;
+        memcpy(&passoIndice, indice + 16 * lo, 8);
+        const char *erro = passo == -1 ? "memória insuficiente" : passo < 0 ? "keyframe corrompido"
+                         : (uint64_t)passo != passoIndice ? "keyframe fora do lugar no índice" : NULL;
+        uint32_t tamKeyframe = 0;
+        uint64_t qtdAcoes = 0;
+        if (erro == NULL) {
+            memcpy(&tamKeyframe, bloco, 4);
+            qtdAcoes = (alvo < proximoPasso ? alvo : proximoPasso) - (uint64_t)passo;
+            if (qtdAcoes > (uint64_t)(tamBloco - tamKeyframe) * 8 / 3) erro = "ações do bloco cortadas";
+        }
+        if (erro != NULL) {
+            fprintf(stderr, "'%s': %s\n", caminho, erro);
+            if (passo >= 0) liberarJogo(&jogo);
+            munmap((void *)mapa, tamArquivo);
+            return 1;
+        }
+
+        // Refaz as ações do bloco até chegar no passo pedido
+        const unsigned char *acoes = bloco + tamKeyframe;
+        modoSilencioso = 1;
+        for (uint64_t n = 0; n < qtdAcoes; n++) {
+            size_t bit = 3 * (size_t)n;
+            unsigned v = acoes[bit >> 3] >> (bit & 7);
+            if ((bit & 7) > 5) v |= (unsigned)acoes[(bit >> 3) + 1] << (8 - (bit & 7));
+            executarAcao(&jogo, (int)(v & 7));
+            refeitas++;
+        }
+        modoSilencioso = 0;
+    }
+
+    printf("Passo    : %llu de %llu (%llu ações refeitas desde o keyframe)\n",
+           (unsigned long long)alvo, (unsigned long long)r.totalPassos, refeitas);
+    exibirFila(&jogo);
+    exibirPilha(&jogo);
+    printf("Resumo   : %016llx\n", resumoEstado(&jogo));
+    liberarJogo(&jogo);
+    munmap((void *)mapa, tamArquivo);
+    return 0;
+}
+
+/* ============================================================= */
+/*  Função: carregarSessao()                                     */
+/*  Continua uma sessão salva com --save (snapshot .tss)        */
+/*  Devolve 0 se não deu (e o jogo fica como estava)            */
+/* ============================================================= */
+int carregarSessao(Jogo *j, const char *caminho) {
+    int fd = open(caminho, O_RDONLY);
+    struct stat info;
+    if (fd < 0 || fstat(fd, &info) != 0) {
+        fprintf(stderr, "Não foi possível abrir '%s'\n", caminho);
+        if (fd >= 0) close(fd);
+        return 0;
+    }
+    size_t tamArquivo = (size_t)info.st_size;
+    if (tamArquivo < sizeof(CabecalhoSnapshot)) {
+        fprintf(stderr, "'%s': %s\n", caminho, mensagensSnapshot[SNAPSHOT_TRUNCADO]);
+        close(fd);
+        return 0;
+    }
+    const unsigned char *mapa = mmap(NULL, tamArquivo, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapa == MAP_FAILED) { fprintf(stderr, "mmap falhou em '%s'\n", caminho); return 0; }
+    int r = restaurarSnapshot(j, mapa, tamArquivo);
+    munmap((void *)mapa, tamArquivo);
+    if (r != SNAPSHOT_OK) { fprintf(stderr, "'%s': %s\n", caminho, mensagensSnapshot[r]); return 0; }
+    MSG("Sessão restaurada de '%s'", caminho);
+    return 1;
+}
+
+/* ============================================================= */
+/*  Função: salvarSessao()                                       */
+/*  Grava o snapshot num arquivo temporário e só então troca o  */
+/*  nome: se algo falhar no meio, o snapshot antigo continua    */
+/*  inteiro. Devolve 0 se não deu.                               */
+/* ============================================================= */
+int salvarSessao(const Jogo *j, const char *caminho) {
+    size_t tam = tamanhoSnapshot(j);
+    unsigned char *dados = malloc(tam);
+    char temporario[4096];
+    if (dados == NULL || snprintf(temporario, sizeof temporario, "%s.tmp", caminho) >= (int)sizeof temporario) {
+        fprintf(stderr, "Não foi possível salvar a sessão em '%s'\n", caminho);
+        free(dados);
+        return 0;
+    }
+    salvarSnapshot(j, dados, tam);
+    FILE *arquivo = fopen(temporario, "wb");
+    int ok = arquivo != NULL && fwrite(dados, 1, tam, arquivo) == tam;
+    if (arquivo != NULL && fclose(arquivo) != 0) ok = 0;
+    if (ok) ok = rename(temporario, caminho) == 0;
+    else if (arquivo != NULL) remove(temporario);
+    if (!ok) fprintf(stderr, "Não foi possível salvar a sessão em '%s'\n", caminho);
+    free(dados);
+    return ok;
+}
+
+/* ============================================================= */
+/*  Função: executarBatch()                                      */
+/*  Modo sem menu: lê um fluxo de ações de um arquivo (ou da    */
+/*  entrada padrão) e aplica tudo sem imprimir nada. No final   */
+/*  mostra só o estado, o resumo e quantas ações por segundo.  */
+/*                                                               */
+/*  Formato do fluxo: cada caractere '1' a '7' é uma ação,      */
+/*  '0' encerra, e qualquer outro caractere (espaço, quebra de */
+/*  linha...) é ignorado. Ex.: "1121534\n" ou "1 1 2 1 5".       */
+/*                                                               */
+/*  Com várias sessões, as ações são distribuídas em rodízio:  */
+/*  a 1ª vai para o jogo 0, a 2ª para o jogo 1, e assim por     */
+/*  diante. Cada jogo tem seu próprio fluxo de peças.           */
+/* ============================================================= */
+int executarBatch(const char *caminho, uint64_t semente, int modo, size_t orcamento, long qtdSessoes,
+                  const char *gravacao, int alimentador, int tabuleiro) {
+    FILE *entrada = stdin;                            // Sem arquivo → lê da entrada padrão
+    if (caminho != NULL && strcmp(caminho, "-") != 0) {
+        entrada = fopen(caminho, "rb");
+        if (entrada == NULL) {
+            fprintf(stderr, "Não foi possível abrir '%s'\n", caminho);
+            return 1;
+        }
+    }
+
+    // Todos os jogos num único bloco alinhado a 64 bytes: cada um
+    // começa numa linha de cache nova
+    Jogo *jogos = aligned_alloc(64, (size_t)qtdSessoes * sizeof(Jogo));
+    if (jogos == NULL) {
+        fprintf(stderr, "Memória insuficiente para %ld sessões\n", qtdSessoes);
+        if (entrada != stdin) fclose(entrada);
+        return 1;
+    }
+    GeradorPecas base, fluxo;
+    iniciarGerador(&base, semente, modo);
+    for (long s = 0; s < qtdSessoes; s++) {           // O jogo 0 recebe o fluxo da própria semente,
+        separarFluxo(&fluxo, &base);                  // cada um dos outros um fluxo independente
+        iniciarJogo(&jogos[s], &fluxo);
+        jogos[s].historico.orcamento = orcamento;
+        if (tabuleiro && !ligarTabuleiro(&jogos[s])) {
+            fprintf(stderr, "Memória insuficiente para os tabuleiros\n");
+            for (long k = 0; k < s; k++) liberarJogo(&jogos[k]);
+            free(jogos);
+            if (entrada != stdin) fclose(entrada);
+            return 1;
+        }
+    }
+
+    static Gravador gravador;
+    if (gravacao != NULL && !abrirGravacao(&gravador, gravacao, &jogos[0], semente, modo)) {
+        free(jogos);
+        if (entrada != stdin) fclose(entrada);
+        return 1;
+    }
+
+    if (alimentador && !ligarAlimentador(&jogos[0])) fprintf(stderr, "Sem alimentador: gerando as peças no jogo\n");
+    ligarMetricas(&jogos[0]);
+    modoSilencioso = 1;                               // Nada de printf durante as ações
+
+    static unsigned char bloco[1 << 16];              // Lê de 64 KB em 64 KB (bem mais rápido que ler ação por ação)
+    unsigned long long acoes = 0;
+    long sessao = 0;                                  // Qual jogo recebe a próxima ação
+    struct timespec ini, fim;
+    timespec_get(&ini, TIME_UTC);
+
+    size_t lidos;
+    int terminou = 0;
+    while (!terminou && (lidos = fread(bloco, 1, sizeof bloco, entrada)) > 0) {
+        if (qtdSessoes == 1 && gravacao == NULL) {    // Um jogo só: o bloco inteiro vai numa chamada
+            static unsigned char codigos[sizeof bloco];
+            size_t m = 0;
+            for (size_t k = 0; k < lidos; k++) {
+                unsigned char c = bloco[k];
+                if (c >= '1' && c <= '7') codigos[m++] = (unsigned char)(c - '0');
+                else if (c == '0') { terminou = 1; break; }
+            }
+            aplicarAcoes(&jogos[0], codigos, m, NULL, NULL);
+            acoes += m;
+            verificarPedidoMetricas();
+            continue;
+        }
+        for (size_t k = 0; k < lidos; k++) {
+            unsigned char c = bloco[k];
+            if (c >= '1' && c <= '7') {               // Ação válida
+                if (gravacao != NULL) gravarAcao(&gravador, &jogos[sessao], c - '0');
+                executarAcao(&jogos[sessao], c - '0');
+                verificarPedidoMetricas();
+                if (++sessao == qtdSessoes) sessao = 0;
+                acoes++;
+            } else if (c == '0') {                    // '0' = sair, igual ao menu
+                terminou = 1;
+                break;
+            }
+        }
+    }
+
+    timespec_get(&fim, TIME_UTC);
+    if (entrada != stdin) fclose(entrada);
+    int gravou = gravacao == NULL || fecharGravacao(&gravador);  // Fora do tempo medido: espera o disco
+    terminarMetricas();
+
+    double segundos = (fim.tv_sec - ini.tv_sec) + (fim.tv_nsec - ini.tv_nsec) / 1e9;
+    modoSilencioso = 0;
+
+    unsigned long long resumo = resumoEstado(&jogos[0]);
+    for (long s = 1; s < qtdSessoes; s++)             // Junta o resumo de todas as sessões
+        resumo = (resumo ^ resumoEstado(&jogos[s])) * 1099511628211ULL;
+
+    exibirFila(&jogos[0]);
+    exibirPilha(&jogos[0]);
+    if (qtdSessoes > 1) printf("Sessões  : %ld (%zu bytes cada)\n", qtdSessoes, sizeof(Jogo));
+    printf("Ações    : %llu\n", acoes);
+    printf("Resumo   : %016llx\n", resumo);
+    printf("Desfazer : %d ações (%zu bytes de arena)\n", jogos[0].historico.qtdDesfazer, jogos[0].historico.capacidade);
+    if (tabuleiro) {
+        const Campo *c = &jogos[0].tabuleiro->campo;
+        printf("Tabuleiro: %u peças, %u linhas, %llu pontos, %u derrotas\n", c->pecas, c->linhasFeitas, c->pontos, c->derrotas);
+    }
+    printf("Ações/s  : %.0f\n", segundos > 0 ? acoes / segundos : 0.0);
+
+    for (long s = 0; s < qtdSessoes; s++) liberarJogo(&jogos[s]);
+    free(jogos);
+    return gravou ? 0 : 1;
+}
+
+/* ============================================================= */
+/*  Função: executarEstresseAlimentador()                        */
+/*  Joga "n" peças em dois jogos com a mesma semente, um com o  */
+/*  alimentador e outro sem, e confere peça por peça: mesma     */
+/*  ordem de tipos e ids únicos e em sequência. O consumidor    */
+/*  alterna rajadas (esvaziam o anel → faltas) e pausas (o      */
+/*  anel enche) para passar pelos dois caminhos.                */
+/* ============================================================= */
+int executarEstresseAlimentador(uint64_t semente, int modo, unsigned long long n) {
+    static Jogo comAlimentador, semAlimentador;
+    GeradorPecas g;
+    iniciarGerador(&g, semente, modo);
+    iniciarJogo(&comAlimentador, &g);
+    iniciarJogo(&semAlimentador, &g);
+    if (!ligarAlimentador(&comAlimentador)) { fprintf(stderr, "Não foi possível criar a thread\n"); return 1; }
+    modoSilencioso = 1;
+
+    GeradorPecas ritmo;                               // Decide quando pausar (independente das peças)
+    iniciarGerador(&ritmo, semente ^ 0xA5A5A5A5ULL, MODO_ALEATORIO);
+    unsigned long long erros = 0;
+    uint64_t idAnterior = UINT64_MAX;                 // "-1": a primeira peça tem id 0
+    struct timespec ini, fim;
+    timespec_get(&ini, TIME_UTC);
+    for (unsigned long long k = 0; k < n; k++) {
+        Peca a = comAlimentador.fila[comAlimentador.frente];
+        Peca b = semAlimentador.fila[semAlimentador.frente];
+        uint64_t idA = idPeca(&comAlimentador, a), idB = idPeca(&semAlimentador, b);
+        if (a.nome != b.nome || idA != idB || idA != idAnterior + 1) {
+            if (erros++ < 10)
+                fprintf(stderr, "Peça %llu: [%c %llu] com alimentador, [%c %llu] sem (id anterior %lld)\n",
+                        k, a.nome, (unsigned long long)idA, b.nome, (unsigned long long)idB, (long long)idAnterior);
+        }
+        idAnterior = idA;
+        jogarPeca(&comAlimentador);
+        jogarPeca(&semAlimentador);
+        if ((k & 4095) == 0 && sortearAte(&ritmo, 4) == 0)   // De vez em quando, uma pausa
+            nanosleep(&(struct timespec){ 0, 200000 }, NULL);
+    }
+    timespec_get(&fim, TIME_UTC);
+    double segundos = (fim.tv_sec - ini.tv_sec) + (fim.tv_nsec - ini.tv_nsec) / 1e9;
+    unsigned long long faltas = comAlimentador.alimentador->faltas;
+    int igual = comAlimentador.gerador.s[0] == semAlimentador.gerador.s[0]
+             && comAlimentador.gerador.s[3] == semAlimentador.gerador.s[3];
+    modoSilencioso = 0;
+
+    printf("Peças    : %llu\n", n);
+    printf("Faltas   : %llu de %llu lotes gerados pelo próprio jogo\n", faltas, n / LOTE_PECAS);
+    printf("Gerador  : %s\n", igual ? "igual ao do jogo sem alimentador" : "DIFERENTE");
+    printf("Erros    : %llu\n", erros);
+    printf("Tempo    : %.3f s\n", segundos);
+    liberarJogo(&comAlimentador);
+    liberarJogo(&semAlimentador);
+    return erros == 0 && igual ? 0 : 1;
+}
+
+/* ============================================================= */
+/*  Função: conferirInvariantes()                                */
+/*  O que tem de valer depois de qualquer ação: fila cheia,     */
+/*  topo == qtdPilha - 1 e ids (de 64 bits) todos diferentes e  */
+/*  menores que o contador. Devolve o problema, ou NULL.         */
+/* ============================================================= */
+static const char *conferirInvariantes(const Jogo *j) {
+    if (j->qtdFila != TAM_FILA) return "fila não está cheia";
+    if (j->qtdPilha > TAM_PILHA || j->topo != j->qtdPilha - 1) return "topo != qtdPilha - 1";
+    uint64_t ids[TAM_FILA + TAM_PILHA], proximo = proximoIdCompleto(j);
+    int n = 0;
+    for (int c = 0, i = j->frente; c < j->qtdFila; c++, i = (i + 1) & MASCARA_FILA) ids[n++] = idPeca(j, j->fila[i]);
+    for (int i = 0; i < j->qtdPilha; i++) ids[n++] = idPeca(j, j->pilha[i]);
+    for (int a = 0; a < n; a++) {
+        if (ids[a] >= proximo) return "id maior que o contador";
+        for (int b = a + 1; b < n; b++) if (ids[a] == ids[b]) return "id repetido";
+    }
+    return NULL;
+}
+
+// Enche "codigos" com "m" ações sorteadas de 1 a 7 (o 0 vira 1: jogar
+// sai duas vezes mais que as outras)
+static void sortearAcoes(GeradorPecas *sorteio, unsigned char *codigos, size_t m) {
+    for (size_t k = 0; k < m; ) {                 // 21 ações de 3 bits por número sorteado
+        uint64_t r = proximoAleatorio(sorteio);
+        for (int b = 0; b < 21 && k < m; b++, r >>= 3) codigos[k++] = (r & 7) ? (unsigned char)(r & 7) : 1;
+    }
+}
+
+/* ============================================================= */
+/*  Função: executarSoak()                                       */
+/*  Uma sessão só, "n" ações sorteadas (1 a 7; jogar vale por   */
+/*  dois) em lotes de 4096 pelo aplicarAcoes, conferindo as     */
+/*  invariantes depois de cada lote. A cada "intervalo" ações   */
+/*  sai a vazão daquele trecho: se ela cai com o tempo (memória */
+/*  crescendo, histórico degradando...), aparece no "desvio".   */
+/*  Com 10^10 ações os ids passam de 2^32 no meio do caminho.   */
+/* ============================================================= */
+int executarSoak(uint64_t semente, int modo, size_t orcamento, unsigned long long n, unsigned long long intervalo) {
+    static Jogo jogo;
+    static unsigned char codigos[4096];
+    GeradorPecas g, sorteio;
+    iniciarGerador(&g, semente, modo);
+    iniciarJogo(&jogo, &g);
+    jogo.historico.orcamento = orcamento;
+    iniciarGerador(&sorteio, semente ^ 0x5A5A5A5AULL, MODO_ALEATORIO);   // As ações (independente das peças)
+    if (intervalo == 0) intervalo = n / 10 > sizeof codigos ? n / 10 : sizeof codigos;
+
+    unsigned long long feitas = 0, certas = 0, erros = 0, proximoRelatorio = intervalo;
+    double primeira = 0, ultima = 0, menor = 0, maior = 0;
+    struct timespec ini, trecho, agora;
+    timespec_get(&ini, TIME_UTC);
+    trecho = agora = ini;                         // Com n = 0 o laço não roda e o total usa o próprio início
+    unsigned long long inicioTrecho = 0;
+    while (feitas < n) {
+        size_t m = sizeof codigos;
+        if (n - feitas < m) m = (size_t)(n - feitas);
+        sortearAcoes(&sorteio, codigos, m);
+        certas += aplicarAcoes(&jogo, codigos, m, NULL, NULL);
+        feitas += m;
+        const char *problema = conferirInvariantes(&jogo);
+        if (problema != NULL && erros++ < 10)
+            fprintf(stderr, "Ação %llu: %s\n", feitas, problema);
+
+        if (feitas >= proximoRelatorio || feitas == n) {
+            timespec_get(&agora, TIME_UTC);
+            double segundos = (agora.tv_sec - trecho.tv_sec) + (agora.tv_nsec - trecho.tv_nsec) / 1e9;
+            double vazao = segundos > 0 ? (feitas - inicioTrecho) / segundos / 1e6 : 0.0;
+            if (inicioTrecho == 0) primeira = menor = maior = vazao;
+            if (vazao < menor) menor = vazao;
+            if (vazao > maior) maior = vazao;
+            ultima = vazao;
+            printf("ações %14llu  %8.2f M/s  ids %llu\n", feitas, vazao, (unsigned long long)proximoIdCompleto(&jogo));
+            fflush(stdout);
+            trecho = agora;
+            inicioTrecho = feitas;
+            proximoRelatorio += intervalo;
+        }
+    }
+    double segundos = (agora.tv_sec - ini.tv_sec) + (agora.tv_nsec - ini.tv_nsec) / 1e9;
+
+    printf("Ações    : %llu (%llu deram certo)\n", feitas, certas);
+    printf("Ids      : %llu (época %u)\n", (unsigned long long)proximoIdCompleto(&jogo), jogo.epocaId);
+    printf("Vazão    : %.2f M/s no total; trechos de %.2f a %.2f M/s\n",
+           segundos > 0 ? feitas / segundos / 1e6 : 0.0, menor, maior);
+    printf("Desvio   : %+.1f%% (último trecho contra o primeiro)\n", primeira > 0 ? 100.0 * (ultima - primeira) / primeira : 0.0);
+    printf("Erros    : %llu\n", erros);
+    printf("Resumo   : %016llx\n", resumoEstado(&jogo));
+    liberarJogo(&jogo);
+    return erros == 0 ? 0 : 1;
+}
+
+/* ============================================================= */
+/*  Função: executarConferenciaSnapshot()                        */
+/*  Ida e volta do snapshot: joga "n" ações sorteadas num jogo  */
+/*  com tabuleiro, salva, restaura num outro jogo e compara o   */
+/*  resumo e o tabuleiro (e as 1000 ações seguintes nos dois,   */
+/*  para pegar o histórico do desfazer). Depois estraga o      */
+/*  snapshot de dois jeitos, um de cada vez:                    */
+/*    - troca um bit sorteado (4096 vezes)                      */
+/*    - corta o arquivo: todo tamanho até o fim do keyframe     */
+/*      fixo, mais 4096 tamanhos sorteados                      */
+/*  Cada restauração estragada tem que dar erro E deixar o jogo */
+/*  exatamente como estava.                                      */
+/* ============================================================= */
+// 1 se "b" é igual a "a" (resumo e tabuleiro)
+static int mesmoJogo(const Jogo *a, const Jogo *b) {
+    if (resumoEstado(a) != resumoEstado(b)) return 0;
+    if ((a->tabuleiro == NULL) != (b->tabuleiro == NULL)) return 0;
+    return a->tabuleiro == NULL || memcmp(a->tabuleiro, b->tabuleiro, sizeof(Tabuleiro)) == 0;
+}
+
+int executarConferenciaSnapshot(uint64_t semente, int modo, size_t orcamento, unsigned long long n) {
+    static Jogo original, copia;
+    static unsigned char codigos[4096];
+    GeradorPecas g, sorteio;
+    iniciarGerador(&g, semente, modo);
+    iniciarJogo(&original, &g);
+    original.historico.orcamento = orcamento;
+    iniciarGerador(&g, semente + 1, modo);        // Outro jogo, sem tabuleiro: tudo tem que ser trocado
+    iniciarJogo(&copia, &g);
+    iniciarGerador(&sorteio, semente ^ 0x5A5A5A5AULL, MODO_ALEATORIO);
+    if (!ligarTabuleiro(&original)) { fprintf(stderr, "Memória insuficiente para o tabuleiro\n"); return 1; }
+    for (unsigned long long feitas = 0; feitas < n; ) {
+        size_t m = n - feitas < sizeof codigos ? (size_t)(n - feitas) : sizeof codigos;
+        sortearAcoes(&sorteio, codigos, m);
+        aplicarAcoes(&original, codigos, m, NULL, NULL);
+        feitas += m;
+    }
+
+    size_t tam = tamanhoSnapshot(&original);
+    unsigned char *dados = malloc(tam), *estragado = malloc(tam);
+    if (dados == NULL || estragado == NULL) {
+        fprintf(stderr, "Memória insuficiente para o snapshot\n");
+        free(dados); free(estragado);
+        liberarJogo(&original); liberarJogo(&copia);
+        return 1;
+    }
+    salvarSnapshot(&original, dados, tam);
+    unsigned long long erros = 0;
+
+    int r = restaurarSnapshot(&copia, dados, tam);
+    int igual = r == SNAPSHOT_OK && mesmoJogo(&original, &copia);
+    sortearAcoes(&sorteio, codigos, 1000);        // Daqui para frente os dois jogam igual (desfazer incluso)
+    aplicarAcoes(&original, codigos, 1000, NULL, NULL);
+    aplicarAcoes(&copia, codigos, 1000, NULL, NULL);
+    int igualDepois = igual && mesmoJogo(&original, &copia);
+    erros += !igual + !igualDepois;
+
+    unsigned long long bitsAceitos = 0, bitsMexeram = 0;
+    memcpy(estragado, dados, tam);
+    for (int k = 0; k < 4096; k++) {
+        uint64_t x = proximoAleatorio(&sorteio);
+        size_t pos = (size_t)(x % tam);
+        unsigned char bit = (unsigned char)(1u << ((x >> 40) & 7));
+        estragado[pos] ^= bit;
+        if (restaurarSnapshot(&copia, estragado, tam) == SNAPSHOT_OK) bitsAceitos++;
+        if (!mesmoJogo(&original, &copia)) bitsMexeram++;
+        estragado[pos] ^= bit;
+    }
+
+    unsigned long long cortes = 0, cortesAceitos = 0, cortesMexeram = 0;
+    size_t fixo = sizeof(CabecalhoSnapshot) + BYTES_FIXOS_KEYFRAME;
+    for (size_t k = 0; k < fixo + 4096; k++) {
+        size_t corte = k < fixo ? k : (size_t)(proximoAleatorio(&sorteio) % tam);
+        if (corte >= tam) continue;
+        cortes++;
+        if (restaurarSnapshot(&copia, dados, corte) == SNAPSHOT_OK) cortesAceitos++;
+        if (!mesmoJogo(&original, &copia)) cortesMexeram++;
+    }
+    erros += bitsAceitos + bitsMexeram + cortesAceitos + cortesMexeram;
+
+    printf("Snapshot : %zu bytes depois de %llu ações\n", tam, n);
+    printf("Ida/volta: %s (resumo %016llx)\n", igual && igualDepois ? "igual" : igual ? "diferente depois de mais 1000 ações" : "diferente",
+           resumoEstado(&copia));
+    printf("Bits     : 4096 trocados, %llu aceitos, %llu mexeram no jogo\n", bitsAceitos, bitsMexeram);
+    printf("Cortes   : %llu tamanhos, %llu aceitos, %llu mexeram no jogo\n", cortes, cortesAceitos, cortesMexeram);
+    printf("Erros    : %llu\n", erros);
+    free(dados);
+    free(estragado);
+    liberarJogo(&original);
+    liberarJogo(&copia);
+    return erros == 0 ? 0 : 1;
+}
+
+/* ============================================================= */
+/*  Função: executarConferenciaDesfazer()                        */
+/*  Desfazer com tabuleiro: joga "n" peças (uma por ação),      */
+/*  guardando o resumo e o campo depois de cada uma, e desfaz   */
+/*  até o jogo recusar. Cada desfazer tem que voltar exatamente */
+/*  ao que foi guardado e a recusa tem que vir depois de        */
+/*  FOTOS_TABULEIRO pousos (RESULTADO_SEM_FOTO), ou das "n"     */
+/*  peças se forem menos, sem mexer no jogo. Depois refaz tudo  */
+/*  até o fim e confere que um ramo (bifurcarJogo) também para  */
+/*  na bifurcação, onde começa o tabuleiro dele.                */
+/* ============================================================= */
+// Resumo só das peças (fila na ordem, pilha do fundo ao topo): o
+// resumoEstado() mistura o contador de ids, que o desfazer não volta
+static unsigned long long resumoPecas(const Jogo *j) {
+    unsigned long long h = 1469598103934665603ULL;
+    for (int c = 0, i = j->frente; c < j->qtdFila; c++, i = (i + 1) & MASCARA_FILA)
+        h = (h ^ ((unsigned long long)j->fila[i].nome << 32 | j->fila[i].id)) * 1099511628211ULL;
+    for (int c = 0; c < j->qtdPilha; c++)
+        h = (h ^ ((unsigned long long)j->pilha[c].nome << 32 | j->pilha[c].id)) * 1099511628211ULL;
+    return (h ^ (unsigned long long)(j->qtdFila << 8 | j->qtdPilha)) * 1099511628211ULL;
+}
+
+// 1 se o jogo está nas peças e no campo guardados
+static int mesmoPonto(const Jogo *j, unsigned long long resumo, const Campo *campo) {
+    return resumoPecas(j) == resumo && memcmp(&j->tabuleiro->campo, campo, sizeof *campo) == 0;
+}
+
+int executarConferenciaDesfazer(uint64_t semente, int modo, unsigned long long n) {
+    static Jogo jogo, ramo;
+    GeradorPecas g;
+    iniciarGerador(&g, semente, modo);
+    iniciarJogo(&jogo, &g);
+    jogo.historico.orcamento = (size_t)1 << 30;   // Aqui quem limita é o tabuleiro, não o histórico
+    unsigned long long *resumos = malloc((n + 1) * sizeof *resumos);
+    Campo *campos = malloc((n + 1) * sizeof *campos);
+    if (resumos == NULL || campos == NULL || !ligarTabuleiro(&jogo)) {
+        fprintf(stderr, "Memória insuficiente para a conferência\n");
+        free(resumos); free(campos);
+        liberarJogo(&jogo);
+        return 1;
+    }
+    const unsigned char jogar = 1, voltar = 5, avancar = 7;
+    unsigned char r;
+    unsigned long long erros = 0;
+    resumos[0] = resumoPecas(&jogo);
+    campos[0] = jogo.tabuleiro->campo;
+    for (unsigned long long k = 1; k <= n; k++) {
+        aplicarAcoes(&jogo, &jogar, 1, &r, NULL);
+        erros += r != RESULTADO_OK;
+        resumos[k] = resumoPecas(&jogo);
+        campos[k] = jogo.tabuleiro->campo;
+    }
+
+    // Desfaz até recusar: cada passo tem que cair no ponto guardado
+    unsigned long long desfeitos = 0, diferentes = 0;
+    for (;;) {
+        aplicarAcoes(&jogo, &voltar, 1, &r, NULL);
+        if (r != RESULTADO_OK) break;
+        desfeitos++;
+        if (desfeitos > n || !mesmoPonto(&jogo, resumos[n - desfeitos], &campos[n - desfeitos])) { diferentes++; break; }
+    }
+    unsigned long long esperado = n < FOTOS_TABULEIRO ? n : FOTOS_TABULEIRO;
+    int recusa = r;
+    int parouCerto = desfeitos == esperado && recusa == (n > FOTOS_TABULEIRO ? RESULTADO_SEM_FOTO : RESULTADO_NADA_DESFAZER)
+                  && mesmoPonto(&jogo, resumos[n - desfeitos], &campos[n - desfeitos]);   // A recusa não mexeu
+    erros += diferentes + !parouCerto;
+
+    // Refaz tudo de volta
+    unsigned long long refeitos = 0, diferentesRefazer = 0;
+    for (; refeitos < desfeitos; refeitos++) {
+        aplicarAcoes(&jogo, &avancar, 1, &r, NULL);
+        unsigned long long k = n - desfeitos + refeitos + 1;
+        if (r != RESULTADO_OK || !mesmoPonto(&jogo, resumos[k], &campos[k])) diferentesRefazer++;
+    }
+    aplicarAcoes(&jogo, &avancar, 1, &r, NULL);
+    erros += diferentesRefazer + (r != RESULTADO_NADA_REFAZER);
+
+    // Um ramo desfaz os pousos dele e para na bifurcação
+    int ramoCerto = bifurcarJogo(&ramo, &jogo);
+    if (ramoCerto) {
+        unsigned char acoes[] = { 1, 1, 1, 5, 5, 5, 5 }, resultados[sizeof acoes];
+        aplicarAcoes(&ramo, acoes, sizeof acoes, resultados, NULL);
+        for (size_t k = 0; k < sizeof acoes - 1; k++) ramoCerto &= resultados[k] == RESULTADO_OK;
+        ramoCerto &= n == 0 || resultados[sizeof acoes - 1] == RESULTADO_SEM_FOTO;
+        ramoCerto &= mesmoPonto(&ramo, resumos[n], &campos[n]);
+        liberarJogo(&ramo);
+    }
+    erros += !ramoCerto;
+
+    printf("Pousos   : %llu peças jogadas (FOTOS_TABULEIRO = %d)\n", n, FOTOS_TABULEIRO);
+    printf("Desfazer : %llu voltaram (esperado %llu), %llu diferentes, parou em \"%s\"\n",
+           desfeitos, esperado, diferentes, nomesResultado[recusa]);
+    printf("Refazer  : %llu voltaram ao fim, %llu diferentes\n", refeitos, diferentesRefazer);
+    printf("Ramo     : %s\n", ramoCerto ? "parou na bifurcação" : "passou da bifurcação ou ficou diferente");
+    printf("Erros    : %llu\n", erros);
+    free(resumos);
+    free(campos);
+    liberarJogo(&jogo);
+    return erros == 0 ? 0 : 1;
+}
+
+/* ============================================================= */
+/*  Função: executarAuditoria()                                  */
+/*  Gera "n" peças com o gerador escolhido e passa todas pela   */
+/*  análise (frequência, secas, sequências, qui²), sem jogo e   */
+/*  sem printf por peça. A cada "intervalo" peças sai uma linha */
+/*  de resumo; no fim, a tabela completa.                       */
+/* ============================================================= */
+int executarAuditoria(uint64_t semente, int modo, unsigned long long n, unsigned long long intervalo) {
+    static unsigned char tipos[1 << 16];             // Um bloco de 64 K tipos por vez
+    static AnalisePecas analise;
+    GeradorPecas g;
+    iniciarGerador(&g, semente, modo);
+    iniciarAnalise(&analise);
+    if (intervalo == 0) intervalo = n;
+    unsigned long long proximoResumo = intervalo;
+
+    struct timespec ini, fim;
+    timespec_get(&ini, TIME_UTC);
+    while (analise.total < n) {
+        size_t m = sizeof tipos;
+        if (n - analise.total < m) m = (size_t)(n - analise.total);
+        if (proximoResumo - analise.total < m) m = (size_t)(proximoResumo - analise.total);
+        gerarTiposEmLote(&g, tipos, m);
+        analisarTipos(&analise, tipos, m);
+        if (analise.total == proximoResumo && analise.total < n) {
+            imprimirAnalise(&analise, stdout, 0);
+            fflush(stdout);
+            proximoResumo += intervalo;
+        }
+    }
+    timespec_get(&fim, TIME_UTC);
+    double segundos = (fim.tv_sec - ini.tv_sec) + (fim.tv_nsec - ini.tv_nsec) / 1e9;
+
+    printf("Gerador  : %s, semente %llu\n", modo == MODO_SACO ? "7-bag" : "sorteio", (unsigned long long)semente);
+    imprimirAnalise(&analise, stdout, 1);
+    printf("Tempo    : %.3f s (%.0f M peças/s)\n", segundos, segundos > 0 ? n / segundos / 1e6 : 0.0);
+    return 0;
+}
+
+/* ============================================================= */
+/*  TEMPO REAL (--realtime): gravidade, travamento e latência    */
+/* ============================================================= */
+// No modo normal o jogo só anda quando chega uma linha com Enter. No
+// --realtime o teclado vai sem Enter (modo "cru" do terminal) e o laço
+// espera duas coisas ao mesmo tempo com poll():
+//
+//   - o teclado: a tecla (1 a 7) é executada na hora e o quadro sai
+//     logo em seguida, sem esperar o próximo tique
+//   - um timerfd com período fixo (--hz): cada expiração é um passo
+//     da simulação. A peça da frente "cai" uma linha a cada --gravity
+//     tiques; quando encosta no campo, começa o travamento
+//     (--lock-delay tiques) e, se o jogador não fizer nada, ela é
+//     jogada sozinha (opção 1). Se o laço atrasar, os tiques perdidos
+//     são simulados todos (passo fixo: a partida não depende da
+//     velocidade da máquina)
+//
+// O quadro só é desenhado quando algo visível mudou (renderizar manda
+// só as linhas diferentes). Duas medidas ficam prontas ao sair:
+//   - latência entrada → quadro: de quando o poll() acorda com a tecla
+//     até o write() do quadro voltar
+//   - jitter do tique: quanto depois do instante exato de cada tique
+//     o laço acordou
+// Menos de 1 ms com a máquina ocupada pede prioridade de tempo real
+// (--rt-priority, precisa de permissão): com ela o laço passa na frente
+// dos outros processos e a memória fica travada (sem page fault).
+#define LIMITE_HISTOGRAMA_US 65535    // Baldes de 1 µs; acima disso, vai no último
+
+typedef struct {
+    unsigned long long baldes[LIMITE_HISTOGRAMA_US + 1];
+    unsigned long long n, maximo, acimaDe1ms;
+} Histograma;
+
+static void registrarMicros(Histograma *h, unsigned long long us) {
+    h->baldes[us < LIMITE_HISTOGRAMA_US ? us : LIMITE_HISTOGRAMA_US]++;
+    h->n++;
+    if (us > h->maximo) h->maximo = us;
+    if (us >= 1000) h->acimaDe1ms++;
+}
+
+static unsigned long long percentilMicros(const Histograma *h, double q) {
+    unsigned long long acumulado = 0;
+    for (unsigned long long us = 0; us <= LIMITE_HISTOGRAMA_US; us++) {
+        acumulado += h->baldes[us];
+        if ((double)acumulado >= q * (double)h->n) return us;
+    }
+    return LIMITE_HISTOGRAMA_US;
+}
+
+static void imprimirHistograma(const char *nome, const Histograma *h) {
+    if (h->n == 0) { fprintf(stderr, "%s: nenhuma amostra\n", nome); return; }
+    fprintf(stderr, "%s: p50 %llu µs, p99 %llu µs, máx %llu µs (%llu amostras, %llu com 1 ms ou mais)\n",
+            nome, percentilMicros(h, 0.5), percentilMicros(h, 0.99), h->maximo, h->n, h->acimaDe1ms);
+}
+
+static unsigned long long agoraNs(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return (unsigned long long)t.tv_sec * 1000000000ULL + (unsigned long long)t.tv_nsec;
+}
+
+static struct termios terminalOriginal;
+static int terminalCru = 0;                       // 1 = precisa devolver o terminal ao sair
+static volatile sig_atomic_t pararTempoReal = 0;
+
+static void devolverTerminal(void) {
+    if (terminalCru) tcsetattr(STDIN_FILENO, TCSAFLUSH, &terminalOriginal);
+    terminalCru = 0;
+}
+static void tratarParada(int sinal) { (void)sinal; pararTempoReal = 1; }
+
+// Teclado sem Enter e sem eco (o resto do terminal fica como estava)
+static void ligarTerminalCru(void) {
+    if (!isatty(STDIN_FILENO) || tcgetattr(STDIN_FILENO, &terminalOriginal) != 0) return;
+    struct termios t = terminalOriginal;
+    t.c_lflag &= ~(tcflag_t)(ICANON | ECHO);
+    t.c_cc[VMIN] = 1;
+    t.c_cc[VTIME] = 0;
+    if (tcsetattr(STDIN_FILENO, TCSAFLUSH, &t) == 0) { terminalCru = 1; atexit(devolverTerminal); }
+}
+
+typedef struct {
+    int linha;                        // Linha onde está a peça da frente (ALTURA_TAB = acabou de aparecer)
+    int tiquesQueda;                  // Tiques desde a última linha descida
+    int tiquesTravando;               // Tiques encostada (0 = ainda caindo)
+    uint64_t idFrente;                // De qual peça é essa queda
+} Queda;
+
+// A peça da frente mudou (jogou, reservou, desfez...): nova queda
+static int acompanharFrente(Queda *q, const Jogo *j) {
+    uint64_t id = j->qtdFila > 0 ? idPeca(j, j->fila[j->frente]) : UINT64_MAX;
+    if (id == q->idFrente) return 0;
+    q->idFrente = id;
+    q->linha = ALTURA_TAB;
+    q->tiquesQueda = q->tiquesTravando = 0;
+    return 1;
+}
+
+// Um passo fixo da simulação. Devolve 1 se algo visível mudou.
+static int passoSimulacao(Queda *q, Jogo *j, Gravador *gravador, int gravidade, int travamento) {
+    int chao = j->tabuleiro != NULL ? j->tabuleiro->campo.altura : 0;   // Onde a peça encosta
+    if (q->linha > chao) {
+        if (++q->tiquesQueda < gravidade) return 0;
+        q->tiquesQueda = 0;
+        q->linha--;
+        return 1;
+    }
+    if (q->tiquesTravando++ == 0) return 1;       // Acabou de encostar: mostra "travando"
+    if (q->tiquesTravando < travamento) return 0;
+    limparStatus();
+    if (gravador != NULL) gravarAcao(gravador, j, 1);
+    executarAcao(j, 1);                           // Travou: joga sozinha
+    acompanharFrente(q, j);
+    return 1;
+}
+
+static void montarLinhaQueda(const Queda *q, const Jogo *j, int hz, int travamento) {
+    int chao = j->tabuleiro != NULL ? j->tabuleiro->campo.altura : 0;
+    if (q->linha > chao) snprintf(linhaPrompt, sizeof linhaPrompt, "→ caindo: linha %d de %d", q->linha, ALTURA_TAB);
+    else snprintf(linhaPrompt, sizeof linhaPrompt, "→ travando: %.2f s", (double)(travamento - q->tiquesTravando) / hz);
+}
+
+/* ============================================================= */
+/*  Função: executarTempoReal()                                  */
+/*  O laço do --realtime (veja o comentário acima)              */
+/* ============================================================= */
+int executarTempoReal(Jogo *j, Gravador *gravador, int hz, int gravidade, int travamento, int prioridade) {
+    static Histograma latencia, jitter;
+    prctl(PR_SET_TIMERSLACK, 1UL, 0, 0, 0);       // O kernel pode juntar timers em até 50 µs; aqui, 1 µs
+    int temPrioridade = 0;
+    if (prioridade > 0) {
+        struct sched_param p = { .sched_priority = prioridade };
+        temPrioridade = sched_setscheduler(0, SCHED_FIFO, &p) == 0;
+        if (temPrioridade) mlockall(MCL_CURRENT | MCL_FUTURE);
+        else fprintf(stderr, "Sem permissão para --rt-priority (precisa de CAP_SYS_NICE): seguindo sem\n");
+    }
+
+    int relogio = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (relogio < 0) { fprintf(stderr, "Não foi possível criar o timerfd\n"); return 1; }
+    long periodo = 1000000000L / hz;
+    struct itimerspec intervalo = { { 0, periodo }, { 0, periodo } };
+    unsigned long long inicio = agoraNs(), tiques = 0, atrasados = 0;
+    timerfd_settime(relogio, 0, &intervalo, NULL);
+
+    struct sigaction acao = { 0 };
+    acao.sa_handler = tratarParada;
+    sigaction(SIGINT, &acao, NULL);
+    sigaction(SIGTERM, &acao, NULL);
+    ligarTerminalCru();
+
+    Queda queda = { 0 };
+    queda.idFrente = UINT64_MAX - 1;
+    acompanharFrente(&queda, j);
+    montarLinhaQueda(&queda, j, hz, travamento);
+    renderizar(j);
+
+    struct pollfd esperas[2] = { { STDIN_FILENO, POLLIN, 0 }, { relogio, POLLIN, 0 } };
+    int rodando = 1;
+    while (rodando && !pararTempoReal) {
+        if (poll(esperas, 2, -1) < 0) continue;   // EINTR: o laço confere pararTempoReal
+        unsigned long long acordou = agoraNs();
+        int mudou = 0, teclou = 0;
+
+        if (esperas[0].revents & (POLLIN | POLLHUP)) {   // Teclado primeiro: é o que tem pressa
+            unsigned char teclas[64];
+            ssize_t n = read(STDIN_FILENO, teclas, sizeof teclas);
+            if (n <= 0) rodando = 0;                  // Fim da entrada
+            for (ssize_t k = 0; k < n && rodando; k++) {
+                int op = teclas[k] - '0';
+                if (teclas[k] == 'q' || op == 0) { rodando = 0; break; }
+                if (op < 1 || op > 7) continue;       // Enter, espaço, outras teclas: nada
+                limparStatus();
+                if (gravador != NULL) gravarAcao(gravador, j, op);
+                executarAcao(j, op);
+                acompanharFrente(&queda, j);
+                mudou = teclou = 1;
+            }
+        }
+        if (esperas[1].revents & POLLIN) {
+            uint64_t expiracoes = 0;
+            if (read(relogio, &expiracoes, sizeof expiracoes) == sizeof expiracoes && expiracoes > 0) {
+                tiques += expiracoes;
+                atrasados += expiracoes - 1;
+                unsigned long long previsto = inicio + tiques * (unsigned long long)periodo;
+                registrarMicros(&jitter, acordou > previsto ? (acordou - previsto) / 1000 : 0);
+                for (uint64_t t = 0; t < expiracoes; t++)
+                    mudou |= passoSimulacao(&queda, j, gravador, gravidade, travamento);
+            }
+        }
+        if (mudou && rodando) {
+            montarLinhaQueda(&queda, j, hz, travamento);
+            renderizar(j);
+            if (teclou) registrarMicros(&latencia, (agoraNs() - acordou) / 1000);
+        }
+        verificarPedidoMetricas();
+    }
+    devolverTerminal();
+    close(relogio);
+    linhaPrompt[0] = '\0';
+
+    double segundos = (agoraNs() - inicio) / 1e9;
+    fprintf(stderr, "\nTiques   : %llu a %d Hz em %.1f s (%llu atrasados)%s\n", tiques, hz, segundos, atrasados,
+            temPrioridade ? ", prioridade de tempo real" : "");
+    imprimirHistograma("Jitter   ", &jitter);
+    imprimirHistograma("Latência ", &latencia);
+    return 0;
+}
+
+/* ============================================================= */
+/*  Função principal – onde o programa começa                   */
+/*                                                               */
+/*  Uso:  ./mestre                          → jogo com menu     */
+/*        ./mestre --batch [arquivo|-]      → modo batch        */
+/*        ./mestre --sessions N ...         → N jogos no batch  */
+/*        ./mestre --seed N ...             → semente fixa      */
+/*        ./mestre --generator bag|random   → 7-bag ou sorteio  */
+/*        ./mestre --undo-budget BYTES ...  → memória do desfazer */
+/*        ./mestre --quiet                  → joga sem desenhar */
+/*        ./mestre --record partida.tsr ... → grava a partida   */
+/*        ./mestre --replay partida.tsr [--step N] → volta nela */
+/*        ./mestre --realtime [--hz N] [--gravity T]          */
+/*                 [--lock-delay T] [--rt-priority P] → jogo    */
+/*                 com tempo (teclas sem Enter, a peça cai)      */
+/*        ./mestre --save sessao.tss ...    → salva a sessão ao */
+/*                 sair; --load sessao.tss continua dali         */
+/*        ./mestre --feed ...               → peças geradas por */
+/*                 outra thread                                  */
+/*        ./mestre --feed-stress N          → confere o --feed  */
+/*        ./mestre --board ...              → as peças jogadas  */
+/*                 caem num tabuleiro de verdade                 */
+/*        ./mestre --soak N [--soak-every M] → N ações numa    */
+/*                 sessão, conferindo as invariantes             */
+/*        ./mestre --snapshot-check N       → salva depois de N */
+/*                 ações, restaura e estraga o snapshot          */
+/*        ./mestre --undo-check N           → joga N peças no   */
+/*                 tabuleiro e desfaz/refaz tudo que der         */
+/*        ./mestre --audit N [--audit-every M] → analisa N peças */
+/*                 do gerador (frequência, secas, qui²)          */
+/*        ./mestre --metrics json|prom ...  → métricas (precisa */
+/*                 compilar com -DTETRIS_METRICAS)              */
+/* ============================================================= */
+int main(int argc, char *argv[]) {
+    if (!CONFERIR_BIBLIOTECA()) return 1;    // Compilado com outra configuração da biblioteca
+    uint64_t semente = (uint64_t)time(NULL);  // Por padrão, peças diferentes a cada execução
+    int modo = MODO_ALEATORIO;                // Por padrão, cada peça é sorteada sozinha
+    size_t orcamento = ORCAMENTO_DESFAZER_PADRAO;
+    long qtdSessoes = 1;                      // Quantos jogos o modo batch roda juntos
+    int batch = 0;                            // 1 = rodar no modo batch
+    int quieto = 0;                           // 1 = não desenha a tela (--quiet)
+    const char *arquivoBatch = NULL;          // NULL = entrada padrão
+    int alimentador = 0;                      // 1 = thread produtora de peças (--feed)
+    int tabuleiro = 0;                        // 1 = peças jogadas caem num tabuleiro (--board)
+    unsigned long long estresse = 0;          // --feed-stress N: quantas peças conferir
+    unsigned long long soak = 0;              // --soak N: quantas ações na sessão longa
+    unsigned long long intervaloSoak = 0;     // --soak-every M: vazão a cada M ações (0 = 10 trechos)
+    unsigned long long conferirSnapshot = 0;  // --snapshot-check N: ações antes de salvar
+    unsigned long long conferirDesfazer = 0;  // --undo-check N: peças a jogar e desfazer no tabuleiro
+    unsigned long long auditoria = 0;         // --audit N: quantas peças analisar
+    unsigned long long intervaloAuditoria = 0;   // --audit-every M: resumo a cada M peças (0 = só no fim)
+    const char *gravacao = NULL;              // --record: onde gravar a partida
+    const char *replay = NULL;                // --replay: gravação a abrir
+    int tempoReal = 0;                        // 1 = laço com relógio (--realtime)
+    int hz = 60;                              // --hz: tiques da simulação por segundo
+    int gravidade = 12;                       // --gravity: tiques para a peça descer uma linha
+    int travamento = 30;                      // --lock-delay: tiques encostada até travar
+    int prioridadeRT = 0;                     // --rt-priority: SCHED_FIFO (0 = não pede)
+    const char *carregar = NULL;              // --load: snapshot de onde continuar
+    const char *salvar = NULL;                // --save: onde salvar a sessão ao sair
+    long long passoReplay = -1;               // --step: passo do replay (-1 = fim)
+
+    for (int a = 1; a < argc; a++) {          // Lê os argumentos da linha de comando
+        if (strcmp(argv[a], "--batch") == 0) {
+            batch = 1;
+            if (a + 1 < argc && argv[a + 1][0] != '-') arquivoBatch = argv[++a];
+            else if (a + 1 < argc && strcmp(argv[a + 1], "-") == 0) a++;
+        } else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) {
+            semente = strtoull(argv[++a], NULL, 10);            // Semente fixa → mesma sequência de peças
+        } else if (strcmp(argv[a], "--generator") == 0 && a + 1 < argc) {
+            a++;
+            if (strcmp(argv[a], "bag") == 0) modo = MODO_SACO;
+            else if (strcmp(argv[a], "random") == 0) modo = MODO_ALEATORIO;
+            else { fprintf(stderr, "Gerador desconhecido: %s (use bag ou random)\n", argv[a]); return 1; }
+        } else if (strcmp(argv[a], "--undo-budget") == 0 && a + 1 < argc) {
+            orcamento = strtoul(argv[++a], NULL, 10);           // Limite de bytes do histórico
+        } else if (strcmp(argv[a], "--record") == 0 && a + 1 < argc) {
+            gravacao = argv[++a];
+        } else if (strcmp(argv[a], "--replay") == 0 && a + 1 < argc) {
+            replay = argv[++a];
+        } else if (strcmp(argv[a], "--realtime") == 0) {
+            tempoReal = 1;
+        } else if (strcmp(argv[a], "--hz") == 0 && a + 1 < argc) {
+            hz = atoi(argv[++a]);
+            if (hz < 1 || hz > 10000) { fprintf(stderr, "--hz precisa estar entre 1 e 10000\n"); return 1; }
+        } else if (strcmp(argv[a], "--gravity") == 0 && a + 1 < argc) {
+            gravidade = atoi(argv[++a]);
+            if (gravidade < 1) gravidade = 1;
+        } else if (strcmp(argv[a], "--lock-delay") == 0 && a + 1 < argc) {
+            travamento = atoi(argv[++a]);
+            if (travamento < 1) travamento = 1;
+        } else if (strcmp(argv[a], "--rt-priority") == 0 && a + 1 < argc) {
+            prioridadeRT = atoi(argv[++a]);
+        } else if (strcmp(argv[a], "--load") == 0 && a + 1 < argc) {
+            carregar = argv[++a];
+        } else if (strcmp(argv[a], "--save") == 0 && a + 1 < argc) {
+            salvar = argv[++a];
+        } else if (strcmp(argv[a], "--step") == 0 && a + 1 < argc) {
+            passoReplay = strtoll(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--metrics") == 0 && a + 1 < argc) {
+            a++;
+            if (strcmp(argv[a], "json") == 0) formatoMetricas = 1;
+            else if (strcmp(argv[a], "prom") == 0) formatoMetricas = 2;
+            else { fprintf(stderr, "Formato de métricas desconhecido: %s (use json ou prom)\n", argv[a]); return 1; }
+#ifndef TETRIS_METRICAS
+            fprintf(stderr, "Métricas desligadas: compile com -DTETRIS_METRICAS\n");
+            return 1;
+#endif
+        } else if (strcmp(argv[a], "--metrics-file") == 0 && a + 1 < argc) {
+            arquivoMetricas = argv[++a];
+        } else if (strcmp(argv[a], "--feed") == 0) {
+            alimentador = 1;
+        } else if (strcmp(argv[a], "--board") == 0) {
+            tabuleiro = 1;
+        } else if (strcmp(argv[a], "--feed-stress") == 0 && a + 1 < argc) {
+            estresse = strtoull(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--snapshot-check") == 0 && a + 1 < argc) {
+            conferirSnapshot = strtoull(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--undo-check") == 0 && a + 1 < argc) {
+            conferirDesfazer = strtoull(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--soak") == 0 && a + 1 < argc) {
+            soak = strtoull(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--soak-every") == 0 && a + 1 < argc) {
+            intervaloSoak = strtoull(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--audit") == 0 && a + 1 < argc) {
+            auditoria = strtoull(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--audit-every") == 0 && a + 1 < argc) {
+            intervaloAuditoria = strtoull(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--quiet") == 0) {
+            quieto = 1;
+        } else if (strcmp(argv[a], "--sessions") == 0 && a + 1 < argc) {
+            qtdSessoes = strtol(argv[++a], NULL, 10);
+            if (qtdSessoes < 1) qtdSessoes = 1;
+        } else {
+            fprintf(stderr, "Uso: %s [--seed N] [--generator bag|random] [--undo-budget BYTES]"
+                            " [--batch [arquivo|-]] [--sessions N] [--quiet]"
+                            " [--record arquivo.tsr] [--replay arquivo.tsr [--step N]]"
+                            " [--load sessao.tss] [--save sessao.tss]"
+                            " [--realtime [--hz N] [--gravity T] [--lock-delay T] [--rt-priority P]]"
+                            " [--metrics json|prom [--metrics-file caminho]]"
+                            " [--feed] [--feed-stress N] [--board]"
+                            " [--soak N [--soak-every M]] [--snapshot-check N] [--undo-check N]"
+                            " [--audit N [--audit-every M]]\n", argv[0]);
+            return 1;
+        }
+    }
+
+    if (replay != NULL) return executarReplay(replay, passoReplay);
+    if (estresse > 0) return executarEstresseAlimentador(semente, modo, estresse);
+    if (soak > 0) return executarSoak(semente, modo, orcamento, soak, intervaloSoak);
+    if (conferirSnapshot > 0) return executarConferenciaSnapshot(semente, modo, orcamento, conferirSnapshot);
+    if (conferirDesfazer > 0) return executarConferenciaDesfazer(semente, modo, conferirDesfazer);
+    if (auditoria > 0) return executarAuditoria(semente, modo, auditoria, intervaloAuditoria);
+    if (alimentador && qtdSessoes > 1) {
+        fprintf(stderr, "--feed liga uma thread para uma sessão só (sem --sessions)\n");
+        return 1;
+    }
+    if (gravacao != NULL && qtdSessoes > 1) {
+        fprintf(stderr, "--record grava uma sessão só (sem --sessions)\n");
+        return 1;
+    }
+    if (gravacao != NULL && tabuleiro) {
+        fprintf(stderr, "--record ainda não grava o tabuleiro (sem --board)\n");
+        return 1;
+    }
+    if (tempoReal && (batch || quieto)) {
+        fprintf(stderr, "--realtime é para jogar olhando a tela (sem --batch e sem --quiet)\n");
+        return 1;
+    }
+    if (batch && (carregar != NULL || salvar != NULL)) {
+        fprintf(stderr, "--load e --save valem para uma sessão só (sem --batch)\n");
+        return 1;
+    }
+    if (batch) return executarBatch(arquivoBatch, semente, modo, orcamento, qtdSessoes, gravacao, alimentador, tabuleiro);
+
+    if (quieto) modoSilencioso = 1;           // --quiet: sem tela e sem mensagens
+    telaAnsi = isatty(STDOUT_FILENO);         // Só usa códigos ANSI num terminal de verdade
+
+    static Jogo jogo;       // O jogo do modo interativo
+    inicializar(&jogo, semente, modo);        // Prepara o jogo
+    jogo.historico.orcamento = orcamento;
+    if (carregar != NULL && !carregarSessao(&jogo, carregar)) return 1;   // Orçamento e tabuleiro vêm junto
+    if (alimentador) ligarAlimentador(&jogo);   // Se não der, as peças são geradas no próprio jogo
+    if (tabuleiro && jogo.tabuleiro == NULL && !ligarTabuleiro(&jogo)) { fprintf(stderr, "Memória insuficiente para o tabuleiro\n"); return 1; }
+    static Gravador gravador;
+    if (gravacao != NULL && !abrirGravacao(&gravador, gravacao, &jogo, semente, modo)) return 1;
+    ligarMetricas(&jogo);
+
+    static LeitorAcoes entrada;               // Lê as escolhas de 64 KB em 64 KB (no lugar do scanf)
+    iniciarLeitor(&entrada, STDIN_FILENO);
+
+    if (tempoReal) {
+        executarTempoReal(&jogo, gravacao != NULL ? &gravador : NULL, hz, gravidade, travamento, prioridadeRT);
+    } else if (quieto && gravacao == NULL) {  // Sem tela e sem gravação: as ações vão em lotes
+        static unsigned char codigos[4096];
+        int sair = 0;
+        while (!sair) {
+            size_t m = lerAcoes(&entrada, codigos, sizeof codigos, &sair);
+            aplicarAcoes(&jogo, codigos, m, NULL, NULL);
+            verificarPedidoMetricas();
+        }
+    } else {
+        int op;             // Variável que guarda a opção do jogador
+        do {                // Repete até digitar 0
+            if (!quieto) renderizar(&jogo);   // Mostra o estado atual + opções (só o que mudou)
+            int lido = lerNumero(&entrada, &op);   // Lê a escolha
+            limparStatus();
+
+            if (lido == 0) op = 0;            // Fim da entrada = sair
+            else if (lido < 0) { op = -1; MSG("Entrada inválida!"); }   // Já foi pulada: pede de novo
+            else if (op >= 1 && op <= 7) {
+                if (gravacao != NULL) gravarAcao(&gravador, &jogo, op);
+                executarAcao(&jogo, op);      // Executa a função certa
+            }
+            else if (op != 0) MSG("Opção inválida!");
+            verificarPedidoMetricas();
+        } while (op != 0);  // Sai do loop quando digitar 0 (ou a entrada acabar)
+    }
+
+    int ok = gravacao == NULL || fecharGravacao(&gravador);
+    ok = (salvar == NULL || salvarSessao(&jogo, salvar)) && ok;
+    terminarMetricas();
+    if (!quieto) printf("\nObrigado por jogar, Mestre do Tetris!\n");
+    if (entrada.malformados > 0) fprintf(stderr, "Entradas inválidas ignoradas: %llu\n", entrada.malformados);
+
+    liberarJogo(&jogo);
+    return ok ? 0 : 1;      // Termina o programa (1 = não conseguiu gravar ou salvar a sessão)
+}
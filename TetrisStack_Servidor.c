@@ -0,0 +1,408 @@
+/* ============================================================= */
+/*  TETRIS STACK – SERVIDOR (muitas sessões num processo só)    */
+/* ============================================================= */
+/*  Em vez de um processo por jogador, um daemon aceita         */
+/*  clientes num socket Unix e cuida de milhares de sessões     */
+/*  com epoll, em poucas threads.                                */
+/*                                                               */
+/*    make servidor                                             */
+/*    ./servidor --socket /tmp/tetris.sock --threads 4          */
+/*    ./servidor --socket /tmp/tetris.sock --client 1000 --actions 10000 */
+/*                                                               */
+/*  Cada thread tem o seu epoll e todas vigiam o socket de      */
+/*  escuta (EPOLLEXCLUSIVE: só uma acorda por cliente novo).    */
+/*  Quem aceita o cliente fica com ele até o fim: a sessão      */
+/*  nunca troca de thread, então nenhuma ação precisa de lock.  */
+/*                                                               */
+/*  Protocolo (por conexão = uma sessão):                        */
+/*    cliente → servidor: os mesmos códigos do menu, um byte    */
+/*      cada: '1' a '7' = ação, '0' = sair, '?' = só o estado,  */
+/*      outros bytes (espaço, '\n'...) são ignorados            */
+/*      Depois do '0' o servidor ainda entrega todas as         */
+/*      respostas pendentes e só então fecha a conexão.         */
+/*    servidor → cliente: uma Resposta de 16 bytes por ação     */
+/*      (e uma logo ao conectar, com o estado inicial)          */
+/* ============================================================= */
+
+#define _GNU_SOURCE     // accept4, EPOLLEXCLUSIVE
+#include <stdio.h>      // printf, fprintf
+#include <stdlib.h>     // malloc, free, strtoull
+#include <stdint.h>     // uint64_t
+#include <string.h>     // strcmp, memcpy
+#include <errno.h>      // EAGAIN, EINTR
+#include <signal.h>     // SIGINT/SIGTERM: desligar limpo
+#include <stdatomic.h>  // parar: escrito pelo sinal, lido por todas as threads
+#include <pthread.h>    // threads
+#include <unistd.h>     // read, close, unlink
+#include <fcntl.h>      // fcntl: socket do cliente sem bloquear
+#include <sys/epoll.h>  // epoll
+#include <sys/socket.h> // socket, accept4, send
+#include <sys/un.h>     // sockaddr_un
+#include <sys/resource.h>  // setrlimit: muitas conexões abertas
+
+/* ------------------- MOTOR DO JOGO (libtetrisstack) ---------- */
+#include "tetrisstack.h"
+
+#ifndef TEM_COMPACTO
+#error "as respostas usam o EstadoCompacto: TAM_FILA/TAM_PILHA grandes demais"
+#endif
+
+/* ------------------- RESPOSTA (16 bytes) -------------------- */
+// O estado vai no formato compacto (tipos de 3 bits + quantidades):
+// o cliente tem tudo para desenhar a fila e a reserva. Os ids das
+// peças não vão; proximoId serve para o cliente saber quantas peças
+// já saíram (os 32 bits de baixo: passa de 2^32 e volta para 0).
+typedef struct {
+    uint8_t resultado;                // RESULTADO_* da ação
+    uint8_t acao;                     // Código recebido (0 = estado inicial ou '?')
+    uint16_t reservado;
+    uint32_t proximoId;
+    uint64_t estado;                  // EstadoCompacto
+} Resposta;
+_Static_assert(sizeof(Resposta) == 16, "a resposta tem 16 bytes");
+
+#define ORCAMENTO_DESFAZER_SERVIDOR 4096      // Por sessão: 50k sessões × 4 KB = 200 MB no pior caso
+#define MAX_EVENTOS 256
+#define BYTES_SAIDA 1024                      // Saída pendente por sessão: 50k sessões × 1 KB = 50 MB
+#define LEITURA_MAX (BYTES_SAIDA / sizeof(Resposta))   // Lê no máximo o que cabe responder (64 ações)
+
+typedef struct {
+    Jogo jogo;                        // Primeiro: alinhado a 64 como o Jogo pede
+    int fd;
+    size_t pendente, enviado;         // Bytes da saída esperando o socket aceitar
+    int esperandoEscrita;             // 1 = parou de ler até a saída esvaziar
+    int fechando;                     // 1 = recebeu '0': fecha quando a saída esvaziar
+    unsigned char saida[BYTES_SAIDA];
+} Sessao;
+
+typedef struct {
+    _Alignas(64) int indice;
+    int epoll;
+    pthread_t thread;
+    unsigned long long sessoesAbertas, sessoesTotal, acoes;
+    uint64_t semente;                 // Semente da próxima sessão desta thread
+} Trabalhador;
+
+static int ouvinte = -1;                    // Socket de escuta
+static atomic_int parar = 0;                // Sem lock: pode ser escrito de dentro do sinal
+static int modoPecas = MODO_ALEATORIO;
+static size_t orcamentoSessao = ORCAMENTO_DESFAZER_SERVIDOR;
+static int marcaOuvinte;                    // Endereço que identifica o ouvinte no epoll
+
+static void tratarSinal(int s) {
+    (void)s;
+    int salvo = errno;                      // O sinal pode cair no meio de uma chamada que olha errno
+    atomic_store_explicit(&parar, 1, memory_order_relaxed);
+    errno = salvo;
+}
+
+static void anexarResposta(Sessao *s, int acao, int resultado) {
+    Resposta r = { (uint8_t)resultado, (uint8_t)acao, 0, s->jogo.proximoId, compactar(&s->jogo) };
+    memcpy(s->saida + s->pendente, &r, sizeof r);
+    s->pendente += sizeof r;
+}
+
+static void fecharSessao(Trabalhador *t, Sessao *s) {
+    epoll_ctl(t->epoll, EPOLL_CTL_DEL, s->fd, NULL);
+    if (s->fechando) {
+        // Descarta o que veio depois do '0': fechar com bytes não lidos faz
+        // o cliente receber ECONNRESET em vez do fim das respostas
+        unsigned char descarte[256];
+        while (read(s->fd, descarte, sizeof descarte) > 0) {}
+    }
+    close(s->fd);
+    liberarJogo(&s->jogo);
+    free(s);
+    t->sessoesAbertas--;
+}
+
+// Manda o que der da saída. Devolve 0 se a conexão caiu.
+static int enviarSaida(Trabalhador *t, Sessao *s) {
+    while (s->enviado < s->pendente) {
+        ssize_t n = send(s->fd, s->saida + s->enviado, s->pendente - s->enviado, MSG_NOSIGNAL);
+        if (n > 0) { s->enviado += (size_t)n; continue; }
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+            if (!s->esperandoEscrita) {       // Socket cheio: espera poder escrever e para de ler
+                // Sem RDHUP: o cliente pode ter fechado só o lado dele e ainda
+                // estar lendo. Se ele sumir de vez, vem EPOLLHUP/EPOLLERR.
+                struct epoll_event ev = { .events = EPOLLOUT, .data.ptr = s };
+                epoll_ctl(t->epoll, EPOLL_CTL_MOD, s->fd, &ev);
+                s->esperandoEscrita = 1;
+            }
+            return 1;
+        }
+        return 0;
+    }
+    s->pendente = s->enviado = 0;
+    if (s->esperandoEscrita && !s->fechando) {   // Esvaziou: volta a ler
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = s };
+        epoll_ctl(t->epoll, EPOLL_CTL_MOD, s->fd, &ev);
+        s->esperandoEscrita = 0;
+    }
+    return 1;
+}
+
+static void aceitarClientes(Trabalhador *t) {
+    for (;;) {
+        int fd = accept4(ouvinte, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0) return;                   // EAGAIN: outra thread pegou, ou acabou a fila
+        Sessao *s = aligned_alloc(64, sizeof(Sessao));
+        if (s == NULL) { close(fd); continue; }
+        GeradorPecas g;
+        iniciarGerador(&g, t->semente++, modoPecas);
+        iniciarJogo(&s->jogo, &g);
+        s->jogo.historico.orcamento = orcamentoSessao;
+        s->fd = fd;
+        s->pendente = s->enviado = 0;
+        s->esperandoEscrita = 0;
+        s->fechando = 0;
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLRDHUP, .data.ptr = s };
+        if (epoll_ctl(t->epoll, EPOLL_CTL_ADD, fd, &ev) != 0) { liberarJogo(&s->jogo); free(s); close(fd); continue; }
+        t->sessoesAbertas++;
+        t->sessoesTotal++;
+        anexarResposta(s, 0, RESULTADO_OK);  // Estado inicial
+        if (!enviarSaida(t, s)) fecharSessao(t, s);
+    }
+}
+
+// Lê e executa as ações que chegaram. Devolve 0 se a sessão acabou
+// (ou, depois de um '0', se já não há nada para entregar).
+static int atenderSessao(Trabalhador *t, Sessao *s) {
+    unsigned char entrada[LEITURA_MAX];
+    for (;;) {
+        if (s->esperandoEscrita || s->fechando) return 1;   // Cliente não está lendo: não aceita mais ações
+        ssize_t n = read(s->fd, entrada, sizeof entrada);
+        if (n == 0) return 0;                 // Cliente fechou
+        if (n < 0) return errno == EAGAIN || errno == EWOULDBLOCK || errno == EINTR;
+        for (ssize_t k = 0; k < n; k++) {
+            unsigned char c = entrada[k];
+            if (c >= '1' && c <= '7') {
+                anexarResposta(s, c - '0', executarAcao(&s->jogo, c - '0'));
+                t->acoes++;
+            } else if (c == '?') {
+                anexarResposta(s, 0, RESULTADO_OK);
+            } else if (c == '0') {
+                // O resto da leitura é descartado; o que já foi respondido
+                // sai pelo EPOLLOUT se o socket não aceitar tudo agora
+                s->fechando = 1;
+                return enviarSaida(t, s) && s->pendente > 0;
+            }
+        }
+        if (!enviarSaida(t, s)) return 0;
+    }
+}
+
+static void *rodarTrabalhador(void *arg) {
+    Trabalhador *t = arg;
+    struct epoll_event eventos[MAX_EVENTOS];
+    while (!atomic_load_explicit(&parar, memory_order_relaxed)) {
+        int n = epoll_wait(t->epoll, eventos, MAX_EVENTOS, 500);
+        for (int i = 0; i < n; i++) {
+            if (eventos[i].data.ptr == &marcaOuvinte) { aceitarClientes(t); continue; }
+            Sessao *s = eventos[i].data.ptr;
+            int viva = 1;
+            if (eventos[i].events & EPOLLOUT) viva = enviarSaida(t, s) && !(s->fechando && s->pendente == 0);
+            if (viva && (eventos[i].events & EPOLLIN)) viva = atenderSessao(t, s);
+            if (viva && (eventos[i].events & (EPOLLERR | EPOLLHUP))) viva = 0;
+            if (!viva) fecharSessao(t, s);
+        }
+    }
+    return NULL;
+}
+
+/* ============================================================= */
+/*  Função: servir()                                             */
+/* ============================================================= */
+static int servir(const char *caminho, int qtdThreads, uint64_t semente) {
+    ouvinte = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    struct sockaddr_un end = { .sun_family = AF_UNIX };
+    if (ouvinte < 0 || strlen(caminho) >= sizeof end.sun_path) { fprintf(stderr, "Socket inválido\n"); return 1; }
+    strcpy(end.sun_path, caminho);
+    unlink(caminho);                              // Sobra de uma execução anterior
+    if (bind(ouvinte, (struct sockaddr *)&end, sizeof end) != 0 || listen(ouvinte, SOMAXCONN) != 0) {
+        fprintf(stderr, "Não foi possível escutar em '%s': %s\n", caminho, strerror(errno));
+        return 1;
+    }
+
+    signal(SIGINT, tratarSinal);
+    signal(SIGTERM, tratarSinal);
+    signal(SIGPIPE, SIG_IGN);
+
+    Trabalhador *trabalhadores = aligned_alloc(64, (size_t)qtdThreads * sizeof(Trabalhador));
+    if (trabalhadores == NULL) { fprintf(stderr, "Memória insuficiente\n"); return 1; }
+    for (int i = 0; i < qtdThreads; i++) {
+        Trabalhador *t = &trabalhadores[i];
+        memset(t, 0, sizeof *t);
+        t->indice = i;
+        t->semente = semente ^ ((uint64_t)i << 48);   // Sessões de threads diferentes não repetem sementes
+        t->epoll = epoll_create1(EPOLL_CLOEXEC);
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLEXCLUSIVE, .data.ptr = &marcaOuvinte };
+        epoll_ctl(t->epoll, EPOLL_CTL_ADD, ouvinte, &ev);
+    }
+    printf("Servindo em %s com %d threads (Ctrl+C para parar)\n", caminho, qtdThreads);
+    fflush(stdout);
+
+    for (int i = 1; i < qtdThreads; i++) pthread_create(&trabalhadores[i].thread, NULL, rodarTrabalhador, &trabalhadores[i]);
+    rodarTrabalhador(&trabalhadores[0]);
+    for (int i = 1; i < qtdThreads; i++) pthread_join(trabalhadores[i].thread, NULL);
+
+    unsigned long long total = 0, acoes = 0, abertas = 0;
+    for (int i = 0; i < qtdThreads; i++) {
+        total += trabalhadores[i].sessoesTotal;
+        acoes += trabalhadores[i].acoes;
+        abertas += trabalhadores[i].sessoesAbertas;
+        close(trabalhadores[i].epoll);
+    }
+    printf("\nSessões  : %llu atendidas (%llu ainda abertas ao parar)\n", total, abertas);
+    printf("Ações    : %llu\n", acoes);
+    close(ouvinte);
+    unlink(caminho);
+    free(trabalhadores);
+    return 0;
+}
+
+/* ============================================================= */
+/*  Função: rodarClientes()                                      */
+/*  Cliente de carga: abre N conexões, manda "acoes" ações      */
+/*  sorteadas em cada uma e confere se chegou uma resposta por  */
+/*  ação. Tudo numa thread só, com epoll.                        */
+/* ============================================================= */
+typedef struct {
+    int fd;
+    unsigned long long enviadas, recebidas;   // Ações enviadas / respostas recebidas (com a inicial)
+    size_t parcial;                            // Bytes de uma resposta que chegou pela metade
+    unsigned char resto[sizeof(Resposta)];
+    uint64_t ultimoEstado;
+} Cliente;
+
+static int rodarClientes(const char *caminho, int qtd, unsigned long long acoes, uint64_t semente) {
+    Cliente *clientes = calloc((size_t)qtd, sizeof(Cliente));
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (clientes == NULL || ep < 0) { fprintf(stderr, "Memória insuficiente\n"); return 1; }
+    struct sockaddr_un end = { .sun_family = AF_UNIX };
+    snprintf(end.sun_path, sizeof end.sun_path, "%s", caminho);
+    signal(SIGPIPE, SIG_IGN);
+
+    for (int i = 0; i < qtd; i++) {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0 || connect(fd, (struct sockaddr *)&end, sizeof end) != 0) {
+            fprintf(stderr, "Conexão %d falhou: %s\n", i, strerror(errno));
+            return 1;
+        }
+        fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);   // Conecta bloqueando, depois vira não bloqueante
+        clientes[i].fd = fd;
+        struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT, .data.ptr = &clientes[i] };
+        epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+    }
+
+    GeradorPecas sorteio;
+    iniciarGerador(&sorteio, semente, MODO_ALEATORIO);
+    struct timespec ini, fim;
+    timespec_get(&ini, TIME_UTC);
+    int terminados = 0;
+    struct epoll_event eventos[MAX_EVENTOS];
+    unsigned char buf[64 * 1024];
+    while (terminados < qtd) {
+        int n = epoll_wait(ep, eventos, MAX_EVENTOS, 5000);
+        if (n == 0) { fprintf(stderr, "Servidor parou de responder\n"); return 1; }
+        for (int i = 0; i < n; i++) {
+            Cliente *c = eventos[i].data.ptr;
+            if (eventos[i].events & EPOLLOUT) {
+                // Manda um bloco de ações (no máximo 1024 à frente das respostas)
+                unsigned long long falta = acoes - c->enviadas;
+                unsigned long long adiantadas = c->enviadas + 1 - c->recebidas;
+                size_t m = 0;
+                while (m < falta && m + adiantadas < 1024 && m < sizeof buf) buf[m++] = (unsigned char)('1' + sortearAte(&sorteio, 7));
+                if (m > 0) {
+                    ssize_t w = send(c->fd, buf, m, MSG_NOSIGNAL);
+                    if (w > 0) c->enviadas += (unsigned long long)w;
+                }
+                if (c->enviadas == acoes || m == 0) {   // Tudo enviado ou muito à frente: agora só lê
+                    struct epoll_event ev = { .events = EPOLLIN, .data.ptr = c };
+                    epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+                }
+            }
+            if (eventos[i].events & EPOLLIN) {
+                ssize_t r;
+                while ((r = read(c->fd, buf, sizeof buf)) > 0) {
+                    size_t k = 0;
+                    while (k < (size_t)r) {           // Junta pedaços de respostas
+                        size_t copia = sizeof(Resposta) - c->parcial;
+                        if (copia > (size_t)r - k) copia = (size_t)r - k;
+                        memcpy(c->resto + c->parcial, buf + k, copia);
+                        c->parcial += copia;
+                        k += copia;
+                        if (c->parcial == sizeof(Resposta)) {
+                            Resposta resp;
+                            memcpy(&resp, c->resto, sizeof resp);
+                            c->ultimoEstado = resp.estado;
+                            c->recebidas++;
+                            c->parcial = 0;
+                        }
+                    }
+                }
+                if (c->recebidas == acoes + 1) {
+                    epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+                    terminados++;
+                } else if (c->enviadas < acoes && c->enviadas + 1 - c->recebidas < 1024) {
+                    struct epoll_event ev = { .events = EPOLLIN | EPOLLOUT, .data.ptr = c };
+                    epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+                }
+            }
+        }
+    }
+    timespec_get(&fim, TIME_UTC);
+    double segundos = (fim.tv_sec - ini.tv_sec) + (fim.tv_nsec - ini.tv_nsec) / 1e9;
+
+    uint64_t resumo = 0;
+    for (int i = 0; i < qtd; i++) { resumo ^= hashCompacto(clientes[i].ultimoEstado); close(clientes[i].fd); }
+    printf("Clientes : %d × %llu ações\n", qtd, acoes);
+    printf("Resumo   : %016llx\n", (unsigned long long)resumo);
+    printf("Ações/s  : %.0f\n", segundos > 0 ? qtd * (double)acoes / segundos : 0.0);
+    free(clientes);
+    close(ep);
+    return 0;
+}
+
+/* ============================================================= */
+/*  main() do servidor                                           */
+/* ============================================================= */
+int main(int argc, char *argv[]) {
+    const char *caminho = "/tmp/tetrisstack.sock";
+    int qtdThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t semente = (uint64_t)time(NULL);
+    int clientes = 0;
+    unsigned long long acoes = 1000;
+
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--socket") == 0 && a + 1 < argc) caminho = argv[++a];
+        else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) qtdThreads = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) semente = strtoull(argv[++a], NULL, 10);
+        else if (strcmp(argv[a], "--undo-budget") == 0 && a + 1 < argc) orcamentoSessao = strtoul(argv[++a], NULL, 10);
+        else if (strcmp(argv[a], "--client") == 0 && a + 1 < argc) clientes = atoi(argv[++a]);
+        else if (strcmp(argv[a], "--actions") == 0 && a + 1 < argc) acoes = strtoull(argv[++a], NULL, 10);
+        else if (strcmp(argv[a], "--generator") == 0 && a + 1 < argc) {
+            a++;
+            if (strcmp(argv[a], "bag") == 0) modoPecas = MODO_SACO;
+            else if (strcmp(argv[a], "random") == 0) modoPecas = MODO_ALEATORIO;
+            else { fprintf(stderr, "Gerador desconhecido: %s (use bag ou random)\n", argv[a]); return 1; }
+        } else {
+            fprintf(stderr, "Uso: %s [--socket caminho] [--threads N] [--seed N] [--generator bag|random]"
+                            " [--undo-budget BYTES] [--client N [--actions N]]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (qtdThreads < 1) qtdThreads = 1;
+
+    // Uma conexão = um descritor: sobe o limite de arquivos abertos até o máximo permitido
+    struct rlimit lim;
+    if (getrlimit(RLIMIT_NOFILE, &lim) == 0 && lim.rlim_cur < lim.rlim_max) {
+        lim.rlim_cur = lim.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &lim);
+    }
+
+    modoSilencioso = 1;
+    if (clientes > 0) return rodarClientes(caminho, clientes, acoes, semente);
+    return servir(caminho, qtdThreads, semente);
+}
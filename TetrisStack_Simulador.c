@@ -0,0 +1,318 @@
+/* ============================================================= */
+/*  TETRIS STACK – SIMULADOR MONTE-CARLO (VÁRIOS NÚCLEOS)       */
+/* ============================================================= */
+/*  Roda milhões de partidas independentes do nível Mestre,     */
+/*  cada uma com sua semente e sua política (quem decide a      */
+/*  próxima ação), espalhadas por todos os núcleos.             */
+/*                                                               */
+/*    make simulador                                            */
+/*    ./simulador --games 1000000 --moves 1000 --threads 64     */
+/*    ./simulador --board ...   → as peças caem num tabuleiro   */
+/*                                e cada partida faz pontos     */
+/*                                                               */
+/*  Divisão do trabalho ("work stealing"): cada thread começa   */
+/*  com uma faixa contínua de partidas [ini, fim). Ela consome  */
+/*  a própria faixa pela frente; quando acaba, rouba a metade   */
+/*  de trás da faixa de outra thread. Nenhum lock: a faixa é um */
+/*  único inteiro de 64 bits trocado com compare-and-swap.      */
+/*                                                               */
+/*  Cada thread soma as estatísticas na SUA estrutura; o main() */
+/*  junta tudo depois do join. O resultado não depende de quem  */
+/*  rodou qual partida: a semente da partida g só depende de g. */
+/* ============================================================= */
+
+#include <stdio.h>      // printf, fprintf
+#include <stdlib.h>     // malloc, free, strtoull
+#include <stdint.h>     // uint64_t
+#include <string.h>     // strcmp, memset
+#include <time.h>       // timespec_get (tempo total da simulação)
+#include <pthread.h>    // threads
+#include <stdatomic.h>  // faixas de trabalho sem lock
+#include <unistd.h>     // sysconf: quantos núcleos a máquina tem
+
+/* ------------------- MOTOR DO JOGO (libtetrisstack) ---------- */
+// As mensagens das ações ficam desligadas pelo modoSilencioso.
+#include "tetrisstack.h"
+
+/* ------------------- POLÍTICAS ------------------------------- */
+// Uma política olha o jogo e devolve o código da ação (1 a 7),
+// igual ao que o jogador digitaria no menu.
+#define POLITICA_SORTEIO   0            // Qualquer ação, sorteada (inclui desfazer/refazer)
+#define POLITICA_SEGURAR_I 1            // Guarda as peças 'I' na reserva e usa quando a reserva enche
+#define POLITICA_SO_JOGAR  2            // Sempre joga a peça da frente (linha de base)
+#define QTD_POLITICAS      3
+
+const char *nomesPolitica[QTD_POLITICAS] = { "random", "hold-i", "play" };
+
+static int escolherAcao(int politica, const Jogo *j, GeradorPecas *sorteio) {
+    switch (politica) {
+        case POLITICA_SORTEIO:
+            return 1 + (int)sortearAte(sorteio, 7);
+        case POLITICA_SEGURAR_I: {
+            char frente = j->fila[j->frente].nome;
+            if (frente == 'I' && j->qtdPilha < TAM_PILHA) return 2;   // Segura a 'I'
+            if (j->qtdPilha == TAM_PILHA) return 3;                   // Reserva cheia: usa uma
+            return 1;
+        }
+        default:
+            return 1;
+    }
+}
+
+/* ------------------- ESTATÍSTICAS ---------------------------- */
+typedef struct {
+    unsigned long long jogos;           // Partidas terminadas
+    unsigned long long acoes;           // Ações aplicadas
+    unsigned long long semEfeito;       // Ações recusadas ("Reserva cheia!", "Nada para desfazer!"...)
+    unsigned long long jogadas;         // Peças que saíram para o tabuleiro
+    unsigned long long minJogadas;      // Menor número de jogadas numa partida
+    unsigned long long maxJogadas;      // Maior número de jogadas numa partida
+    unsigned long long resumo;          // XOR dos resumos finais: não depende da ordem
+    unsigned long long linhas;          // Linhas apagadas no tabuleiro (--board)
+    unsigned long long pontos;          // Pontos do tabuleiro
+    unsigned long long derrotas;        // Vezes que o tabuleiro encheu
+} Estatisticas;
+
+static void juntarEstatisticas(Estatisticas *total, const Estatisticas *parte) {
+    if (parte->jogos == 0) return;
+    if (total->jogos == 0 || parte->minJogadas < total->minJogadas) total->minJogadas = parte->minJogadas;
+    if (parte->maxJogadas > total->maxJogadas) total->maxJogadas = parte->maxJogadas;
+    total->jogos     += parte->jogos;
+    total->acoes     += parte->acoes;
+    total->semEfeito += parte->semEfeito;
+    total->jogadas   += parte->jogadas;
+    total->resumo    ^= parte->resumo;
+    total->linhas    += parte->linhas;
+    total->pontos    += parte->pontos;
+    total->derrotas  += parte->derrotas;
+}
+
+/* ------------------- CONFIGURAÇÃO DA SIMULAÇÃO --------------- */
+typedef struct {
+    uint64_t semente;                   // Semente da simulação inteira
+    int modo;                           // MODO_ALEATORIO ou MODO_SACO
+    int politica;                       // Uma política fixa, ou -1 = partida g usa a política g % QTD_POLITICAS
+    unsigned long long jogadasPorJogo;  // Ações por partida
+    size_t orcamento;                   // Orçamento do desfazer de cada partida
+    int tabuleiro;                      // 1 = as peças jogadas caem num tabuleiro e a partida pontua
+} Configuracao;
+
+/* ------------------- THREADS E FAIXAS ------------------------ */
+// Faixa = (ini << 32) | fim. A faixa (que os ladrões leem) e os
+// contadores (que só a dona escreve) ficam em linhas de cache
+// separadas, e cada Trabalhador começa numa linha nova: uma thread
+// somando os seus contadores não atrapalha as outras (sem "false sharing").
+typedef struct {
+    _Alignas(64) _Atomic uint64_t faixa;
+    _Alignas(64) Estatisticas est[QTD_POLITICAS];
+    unsigned long long roubos;          // Quantas vezes esta thread roubou trabalho
+    int indice;
+} Trabalhador;
+
+static Trabalhador *trabalhadores;
+static int qtdThreads;
+static Configuracao config;
+
+#define FAIXA(ini, fim) (((uint64_t)(ini) << 32) | (uint32_t)(fim))
+
+/* ============================================================= */
+/*  Função: pegarDaPropria()                                     */
+/*  Tira a próxima partida da frente da própria faixa           */
+/*  Devolve 0 se a faixa acabou                                  */
+/* ============================================================= */
+static int pegarDaPropria(Trabalhador *t, uint32_t *jogo) {
+    uint64_t v = atomic_load_explicit(&t->faixa, memory_order_acquire);
+    for (;;) {
+        uint32_t ini = (uint32_t)(v >> 32), fim = (uint32_t)v;
+        if (ini >= fim) return 0;
+        if (atomic_compare_exchange_weak_explicit(&t->faixa, &v, FAIXA(ini + 1, fim),
+                                                  memory_order_acq_rel, memory_order_acquire)) {
+            *jogo = ini;
+            return 1;
+        }
+    }
+}
+
+/* ============================================================= */
+/*  Função: roubar()                                             */
+/*  Procura uma vítima com trabalho e fica com a metade de trás */
+/*  da faixa dela. Devolve 0 se ninguém tem mais nada.          */
+/* ============================================================= */
+static int roubar(Trabalhador *t, uint32_t *jogo) {
+    for (int k = 1; k < qtdThreads; k++) {
+        Trabalhador *v = &trabalhadores[(t->indice + k) % qtdThreads];
+        uint64_t antigo = atomic_load_explicit(&v->faixa, memory_order_acquire);
+        for (;;) {
+            uint32_t ini = (uint32_t)(antigo >> 32), fim = (uint32_t)antigo;
+            if (ini >= fim) break;                        // Vítima sem trabalho: próxima
+            uint32_t meio = ini + (fim - ini) / 2;        // Ela fica com [ini, meio), eu com [meio, fim)
+            if (atomic_compare_exchange_weak_explicit(&v->faixa, &antigo, FAIXA(ini, meio),
+                                                      memory_order_acq_rel, memory_order_acquire)) {
+                *jogo = meio;                             // Começo já pela primeira roubada
+                atomic_store_explicit(&t->faixa, FAIXA(meio + 1, fim), memory_order_release);
+                t->roubos++;
+                return 1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* ============================================================= */
+/*  Função: simularJogo()                                        */
+/*  Roda uma partida inteira e soma o resultado em "est"        */
+/* ============================================================= */
+static void simularJogo(uint32_t g, int politica, Estatisticas *est) {
+    // Semente da partida = mistura da semente geral com o número da
+    // partida: mesma partida, mesmo resultado, em qualquer thread
+    uint64_t z = config.semente ^ ((uint64_t)g * 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 31)) * 0xD6E8FEB86659FD93ULL;
+    GeradorPecas pecas, sorteio;
+    iniciarGerador(&pecas, z, config.modo);
+    iniciarGerador(&sorteio, ~z, MODO_ALEATORIO);     // Os sorteios da política usam outro fluxo
+
+    static _Thread_local Jogo j;                      // Um Jogo por thread, reaproveitado
+    iniciarJogo(&j, &pecas);
+    j.historico.orcamento = config.orcamento;
+    if (config.tabuleiro && !ligarTabuleiro(&j)) { fprintf(stderr, "Memória insuficiente\n"); exit(1); }
+
+    unsigned long long semEfeito = 0, jogadas = 0;
+    for (unsigned long long passo = 0; passo < config.jogadasPorJogo; passo++) {
+        int op = escolherAcao(politica, &j, &sorteio);
+        if (executarAcao(&j, op) != RESULTADO_OK) semEfeito++;
+        else jogadas += (op == 3) ? 2 : (op == 1);    // Usar reservada joga duas
+    }
+
+    if (est->jogos == 0 || jogadas < est->minJogadas) est->minJogadas = jogadas;
+    if (jogadas > est->maxJogadas) est->maxJogadas = jogadas;
+    est->jogos++;
+    est->acoes += config.jogadasPorJogo;
+    est->semEfeito += semEfeito;
+    est->jogadas += jogadas;
+    est->resumo ^= resumoEstado(&j) * (2 * (unsigned long long)g + 1);
+    if (j.tabuleiro != NULL) {
+        const Campo *c = &j.tabuleiro->campo;
+        est->linhas += c->linhasFeitas;
+        est->pontos += c->pontos;
+        est->derrotas += c->derrotas;
+        est->resumo ^= (c->pontos + 1) * 0x9E3779B97F4A7C15ULL * (2 * (unsigned long long)g + 1);
+    }
+    liberarJogo(&j);
+}
+
+static void *rodarTrabalhador(void *arg) {
+    Trabalhador *t = arg;
+    uint32_t g;
+    while (pegarDaPropria(t, &g) || roubar(t, &g)) {
+        int politica = config.politica >= 0 ? config.politica : (int)(g % QTD_POLITICAS);
+        simularJogo(g, politica, &t->est[politica]);
+    }
+    return NULL;
+}
+
+/* ============================================================= */
+/*  main() do simulador                                          */
+/* ============================================================= */
+int main(int argc, char *argv[]) {
+    unsigned long long qtdJogos = 100000;
+    config.semente = 12345;
+    config.modo = MODO_ALEATORIO;
+    config.politica = -1;
+    config.jogadasPorJogo = 1000;
+    config.orcamento = ORCAMENTO_DESFAZER_PADRAO;
+    qtdThreads = (int)sysconf(_SC_NPROCESSORS_ONLN);
+
+    for (int a = 1; a < argc; a++) {
+        if (strcmp(argv[a], "--games") == 0 && a + 1 < argc) {
+            qtdJogos = strtoull(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--moves") == 0 && a + 1 < argc) {
+            config.jogadasPorJogo = strtoull(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--threads") == 0 && a + 1 < argc) {
+            qtdThreads = atoi(argv[++a]);
+        } else if (strcmp(argv[a], "--seed") == 0 && a + 1 < argc) {
+            config.semente = strtoull(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--undo-budget") == 0 && a + 1 < argc) {
+            config.orcamento = strtoul(argv[++a], NULL, 10);
+        } else if (strcmp(argv[a], "--board") == 0) {
+            config.tabuleiro = 1;
+        } else if (strcmp(argv[a], "--generator") == 0 && a + 1 < argc) {
+            a++;
+            if (strcmp(argv[a], "bag") == 0) config.modo = MODO_SACO;
+            else if (strcmp(argv[a], "random") == 0) config.modo = MODO_ALEATORIO;
+            else { fprintf(stderr, "Gerador desconhecido: %s (use bag ou random)\n", argv[a]); return 1; }
+        } else if (strcmp(argv[a], "--policy") == 0 && a + 1 < argc) {
+            a++;
+            config.politica = -2;
+            if (strcmp(argv[a], "all") == 0) config.politica = -1;
+            for (int p = 0; p < QTD_POLITICAS; p++)
+                if (strcmp(argv[a], nomesPolitica[p]) == 0) config.politica = p;
+            if (config.politica == -2) { fprintf(stderr, "Política desconhecida: %s\n", argv[a]); return 1; }
+        } else {
+            fprintf(stderr, "Uso: %s [--games N] [--moves N] [--threads N] [--seed N]"
+                            " [--generator bag|random] [--policy all|random|hold-i|play]"
+                            " [--undo-budget BYTES] [--board]\n", argv[0]);
+            return 1;
+        }
+    }
+    if (qtdThreads < 1) qtdThreads = 1;
+    if (qtdJogos > UINT32_MAX) { fprintf(stderr, "No máximo %u partidas por execução\n", UINT32_MAX); return 1; }
+
+    modoSilencioso = 1;
+    trabalhadores = aligned_alloc(64, (size_t)qtdThreads * sizeof(Trabalhador));
+    pthread_t *threads = malloc((size_t)qtdThreads * sizeof(pthread_t));
+    if (trabalhadores == NULL || threads == NULL) { fprintf(stderr, "Memória insuficiente\n"); return 1; }
+
+    // Faixas iniciais: partes iguais, a sobra vai para as primeiras threads
+    uint32_t inicio = 0;
+    for (int t = 0; t < qtdThreads; t++) {
+        uint32_t tam = (uint32_t)(qtdJogos / qtdThreads + ((unsigned long long)t < qtdJogos % qtdThreads));
+        memset(&trabalhadores[t], 0, sizeof(Trabalhador));
+        trabalhadores[t].indice = t;
+        atomic_init(&trabalhadores[t].faixa, FAIXA(inicio, inicio + tam));
+        inicio += tam;
+    }
+
+    struct timespec ini, fim;
+    timespec_get(&ini, TIME_UTC);
+    for (int t = 1; t < qtdThreads; t++) pthread_create(&threads[t], NULL, rodarTrabalhador, &trabalhadores[t]);
+    rodarTrabalhador(&trabalhadores[0]);          // A thread principal também trabalha
+    for (int t = 1; t < qtdThreads; t++) pthread_join(threads[t], NULL);
+    timespec_get(&fim, TIME_UTC);
+    double segundos = (fim.tv_sec - ini.tv_sec) + (fim.tv_nsec - ini.tv_nsec) / 1e9;
+
+    // Junta as estatísticas de todas as threads (já terminaram: sem lock)
+    Estatisticas total[QTD_POLITICAS] = {{0}}, geral = {0};
+    unsigned long long roubos = 0;
+    for (int t = 0; t < qtdThreads; t++) {
+        for (int p = 0; p < QTD_POLITICAS; p++) juntarEstatisticas(&total[p], &trabalhadores[t].est[p]);
+        roubos += trabalhadores[t].roubos;
+    }
+
+    printf("=== SIMULADOR – %llu partidas × %llu ações, %d threads ===\n",
+           qtdJogos, config.jogadasPorJogo, qtdThreads);
+    printf("%-8s %10s %12s %12s %8s %8s\n", "política", "partidas", "jogadas/jogo", "sem efeito %", "mín", "máx");
+    for (int p = 0; p < QTD_POLITICAS; p++) {
+        if (total[p].jogos == 0) continue;
+        printf("%-8s %10llu %12.1f %12.2f %8llu %8llu\n", nomesPolitica[p], total[p].jogos,
+               (double)total[p].jogadas / total[p].jogos,
+               100.0 * total[p].semEfeito / (total[p].acoes ? total[p].acoes : 1),
+               total[p].minJogadas, total[p].maxJogadas);
+        juntarEstatisticas(&geral, &total[p]);
+    }
+    if (config.tabuleiro) {
+        printf("%-8s %12s %12s %12s\n", "política", "linhas/jogo", "pontos/jogo", "derrotas");
+        for (int p = 0; p < QTD_POLITICAS; p++) {
+            if (total[p].jogos == 0) continue;
+            printf("%-8s %12.1f %12.1f %12llu\n", nomesPolitica[p], (double)total[p].linhas / total[p].jogos,
+                   (double)total[p].pontos / total[p].jogos, total[p].derrotas);
+        }
+    }
+    printf("Resumo   : %016llx\n", geral.resumo);
+    printf("Roubos   : %llu\n", roubos);
+    printf("Tempo    : %.3f s (%.0f partidas/s, %.0f ações/s)\n", segundos,
+           segundos > 0 ? geral.jogos / segundos : 0.0, segundos > 0 ? geral.acoes / segundos : 0.0);
+
+    free(threads);
+    free(trabalhadores);
+    return 0;
+}
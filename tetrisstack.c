@@ -0,0 +1,2285 @@
+/* ============================================================= */
+/*  TETRIS STACK – BIBLIOTECA (libtetrisstack)                  */
+/* ============================================================= */
+/*  O motor do jogo: tudo que os programas usam e que não é     */
+/*  menu nem linha de comando. A descrição de cada estrutura e  */
+/*  a lista de funções ficam em tetrisstack.h.                  */
+/* ============================================================= */
+
+#include <stdio.h>      // Biblioteca para usar printf, snprintf, fopen (exibição, métricas, gravação)
+#include <stdlib.h>     // Biblioteca para usar malloc, free
+#include <string.h>     // Biblioteca para usar memcpy, memset, memcmp
+#include <math.h>       // Biblioteca para usar exp (chance do qui-quadrado)
+#include <time.h>       // Biblioteca para usar timespec (métricas)
+#include <stdarg.h>     // Biblioteca para funções com número variável de argumentos (mensagem)
+#include <sched.h>      // Biblioteca para usar sched_yield (alimentador de peças ocioso)
+#include <errno.h>      // Biblioteca para usar errno (read interrompido por sinal)
+#include <unistd.h>     // Biblioteca para usar read e isatty (leitura das ações)
+#if defined(__SSE2__)
+#include <emmintrin.h>  // Biblioteca do SSE2 (procurar linhas completas do tabuleiro 8 de cada vez)
+#endif
+#include "tetrisstack.h"
+
+/* ------------------- MODO SILENCIOSO E LINHA DE STATUS ------- */
+int modoSilencioso = 0;               // 0 = jogo normal (imprime), 1 = batch (não imprime nada)
+char linhaStatus[COLUNAS_TELA];       // Mensagens da última ação
+size_t tamStatus = 0;                 // Quantos bytes da linha de status estão ocupados
+
+void mensagem(const char *formato, ...) {
+    va_list args;
+    va_start(args, formato);
+    int n = vsnprintf(linhaStatus + tamStatus, sizeof linhaStatus - tamStatus, formato, args);
+    va_end(args);
+    if (n < 0) return;
+    size_t fim = tamStatus + (size_t)n;
+    if (fim >= sizeof linhaStatus) fim = sizeof linhaStatus - 1;   // Cortou: a linha encheu
+    for (size_t i = tamStatus; i < fim; i++)
+        if (linhaStatus[i] == '\n') linhaStatus[i] = ' ';           // Tudo numa linha só
+    tamStatus = fim;
+}
+
+void limparStatus(void) { tamStatus = 0; linhaStatus[0] = '\0'; }
+
+/* ------------------- TABELAS FIXAS -------------------------- */
+const char tiposPeca[7] = {'I', 'O', 'T', 'L', 'J', 'S', 'Z'}; // As 7 peças do Tetris
+
+const char *nomesResultado[QTD_RESULTADOS] = {
+    "ok", "fila_vazia", "reserva_cheia", "reserva_vazia", "troca_impossivel", "nada_desfazer", "nada_refazer",
+    "acao_invalida", "sem_foto"
+};
+
+/* ============================================================= */
+/*  Função: iniciarGerador()                                     */
+/*  Prepara um gerador a partir de uma semente (splitmix64      */
+/*  espalha a semente pelos 256 bits de estado)                 */
+/* ============================================================= */
+void iniciarGerador(GeradorPecas *g, uint64_t semente, int modo) {
+    for (int i = 0; i < 4; i++) {
+        uint64_t z = (semente += 0x9E3779B97F4A7C15ULL);
+        z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+        z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+        g->s[i] = z ^ (z >> 31);
+    }
+    g->modo = modo;
+    g->posSaco = 7;                               // Saco vazio: o primeiro sorteio embaralha
+    g->posLote = LOTE_PECAS;                      // Lote vazio: o primeiro gerarPeca() enche
+    // Saco e lote ainda não valem nada, mas vão para o snapshot e são
+    // conferidos ao restaurar (tipos de 0 a 6): nada de lixo da pilha
+    for (int i = 0; i < 7; i++) g->saco[i] = (unsigned char)i;
+    memset(g->lote, 0, sizeof g->lote);
+}
+
+/* ============================================================= */
+/*  Função: separarFluxo()                                       */
+/*  Cria em "novo" um gerador independente de "base": copia e   */
+/*  avança "base" 2^128 passos (salto do xoshiro). Assim vários */
+/*  jogos podem sair da mesma semente sem repetir sequências.  */
+/* ============================================================= */
+void separarFluxo(GeradorPecas *novo, GeradorPecas *base) {
+    static const uint64_t SALTO[4] = { 0x180EC6D33CFD0ABAULL, 0xD5A61266F0C9392CULL,
+                                       0xA9582618E03FC9AAULL, 0x39ABDC4529B1661CULL };
+    *novo = *base;
+    uint64_t s0 = 0, s1 = 0, s2 = 0, s3 = 0;
+    for (int i = 0; i < 4; i++)
+        for (int b = 0; b < 64; b++) {
+            if (SALTO[i] & (1ULL << b)) {
+                s0 ^= base->s[0]; s1 ^= base->s[1]; s2 ^= base->s[2]; s3 ^= base->s[3];
+            }
+            proximoAleatorio(base);
+        }
+    base->s[0] = s0; base->s[1] = s1; base->s[2] = s2; base->s[3] = s3;
+}
+
+/* ============================================================= */
+/*  Função: gerarTiposEmLote()                                   */
+/*  Enche "destino" com n tipos de peça (0 a 6) de uma vez só.  */
+/*  É aqui que o trabalho pesado acontece; gerarPeca() só lê.   */
+/* ============================================================= */
+void gerarTiposEmLote(GeradorPecas *g, unsigned char *destino, size_t n) {
+    if (g->modo == MODO_SACO) {
+        for (size_t k = 0; k < n; k++) {
+            if (g->posSaco == 7) {                // Saco acabou: embaralha um novo (Fisher-Yates)
+                for (int i = 0; i < 7; i++) g->saco[i] = (unsigned char)i;
+                for (int i = 6; i > 0; i--) {
+                    int j = (int)sortearAte(g, (uint32_t)i + 1);
+                    unsigned char t = g->saco[i]; g->saco[i] = g->saco[j]; g->saco[j] = t;
+                }
+                g->posSaco = 0;
+            }
+            destino[k] = g->saco[g->posSaco++];
+        }
+    } else {
+        for (size_t k = 0; k < n; k++) destino[k] = (unsigned char)sortearAte(g, 7);
+    }
+}
+
+/* ============================================================= */
+/*  ANÁLISE DAS PEÇAS (auditoria do gerador, memória constante) */
+/* ============================================================= */
+// Frequência de cada tipo, "secas" (quantas peças passam entre duas
+// do mesmo tipo: a seca do 'I' é a famosa) e sequências repetidas,
+// contadas direto no fluxo de tipos, lote a lote, sem guardar as
+// peças: bilhões de peças cabem nos mesmos ~4 KB da AnalisePecas.
+//
+// Contar a frequência é o trabalho "largo": com SSE2 são 16 tipos por
+// vez, uma comparação por tipo somando -1 em contadores de 8 bits (que
+// vão para os de 64 bits a cada 255 blocos, antes de estourarem). Secas
+// e sequências dependem da peça anterior, então ficam numa passada
+// escalar só, que mexe em poucos bytes por peça.
+
+// Soma em contagem[t] quantos tipos t existem em tipos[0..n)
+static void contarTipos(unsigned long long contagem[7], const unsigned char *tipos, size_t n) {
+    size_t k = 0;
+#if defined(__SSE2__)
+    const __m128i zero = _mm_setzero_si128();
+    while (n - k >= 16) {
+        __m128i soma[7];
+        for (int t = 0; t < 7; t++) soma[t] = zero;
+        size_t fimBloco = k + 16 * 255;              // 255 blocos: o contador de 8 bits não estoura
+        for (; k + 16 <= n && k < fimBloco; k += 16) {
+            __m128i v = _mm_loadu_si128((const __m128i *)(tipos + k));
+            for (int t = 0; t < 7; t++)               // Igual = 0xFF = -1 → subtrair soma 1
+                soma[t] = _mm_sub_epi8(soma[t], _mm_cmpeq_epi8(v, _mm_set1_epi8((char)t)));
+        }
+        for (int t = 0; t < 7; t++) {
+            uint64_t metades[2];                      // psadbw: soma os 16 bytes em 2 × 64 bits
+            _mm_storeu_si128((__m128i *)metades, _mm_sad_epu8(soma[t], zero));
+            contagem[t] += metades[0] + metades[1];
+        }
+    }
+#endif
+    for (; k < n; k++) if (tipos[k] < 7) contagem[tipos[k]]++;
+}
+
+/* ============================================================= */
+/*  Função: iniciarAnalise()                                     */
+/* ============================================================= */
+void iniciarAnalise(AnalisePecas *a) {
+    memset(a, 0, sizeof *a);
+    a->tipoAnterior = -1;
+}
+
+/* ============================================================= */
+/*  Função: analisarTipos()                                      */
+/*  Soma mais n tipos (0 a 6) do fluxo na análise. Pode ser     */
+/*  chamada com pedaços de qualquer tamanho: secas e sequências */
+/*  continuam de um pedaço para o outro.                        */
+/* ============================================================= */
+void analisarTipos(AnalisePecas *a, const unsigned char *tipos, size_t n) {
+    contarTipos(a->contagem, tipos, n);
+    unsigned long long pos = a->total;
+    int anterior = a->tipoAnterior;
+    unsigned long long sequencia = a->sequencia;
+    for (size_t k = 0; k < n; k++, pos++) {
+        int t = tipos[k];
+        if (t >= 7) continue;
+        unsigned long long ultima = a->ultimaPos[t];   // Posição + 1 da última peça t (0 = nunca veio)
+        if (ultima != 0) {
+            unsigned long long seca = pos - ultima;    // Peças de outros tipos no meio
+            a->secas[t][seca < BALDES_SECA ? seca : BALDES_SECA - 1]++;
+            a->somaSecas[t] += seca;
+            if (seca > a->maiorSeca[t]) a->maiorSeca[t] = seca;
+        }
+        a->ultimaPos[t] = pos + 1;
+        if (t == anterior) { sequencia++; continue; }
+        if (sequencia > 0) {                           // Acabou a sequência do tipo anterior
+            a->sequencias[sequencia < BALDES_SEQUENCIA ? sequencia - 1 : BALDES_SEQUENCIA - 1]++;
+            if (sequencia > a->maiorSequencia) { a->maiorSequencia = sequencia; a->tipoMaiorSequencia = anterior; }
+        }
+        anterior = t;
+        sequencia = 1;
+    }
+    a->total = pos;
+    a->tipoAnterior = anterior;
+    a->sequencia = sequencia;
+}
+
+/* ============================================================= */
+/*  Função: quiQuadrado()                                        */
+/*  Qui-quadrado das frequências contra a distribuição uniforme */
+/*  (6 graus de liberdade). Em *p (se não for NULL) vai a chance */
+/*  de um gerador justo dar um valor pelo menos desse tamanho:  */
+/*  p muito perto de 0 = viés; muito perto de 1 = uniforme      */
+/*  "demais" (é o que o 7-bag faz, de propósito).               */
+/* ============================================================= */
+double quiQuadrado(const AnalisePecas *a, double *p) {
+    double esperado = (double)a->total / 7.0, x = 0.0;
+    if (esperado > 0)
+        for (int t = 0; t < 7; t++) {
+            double d = (double)a->contagem[t] - esperado;
+            x += d * d / esperado;
+        }
+    if (p != NULL) {                                   // Com 6 g.l. (par) a cauda tem forma fechada
+        double m = x / 2.0;
+        *p = exp(-m) * (1.0 + m + m * m / 2.0);
+    }
+    return x;
+}
+
+// Percentil q (0 a 1) da seca do tipo t, pelo histograma
+static unsigned percentilSeca(const AnalisePecas *a, int t, double q) {
+    unsigned long long total = 0, acumulado = 0;
+    for (int b = 0; b < BALDES_SECA; b++) total += a->secas[t][b];
+    if (total == 0) return 0;
+    for (int b = 0; b < BALDES_SECA; b++) {
+        acumulado += a->secas[t][b];
+        if ((double)acumulado >= q * (double)total) return (unsigned)b;
+    }
+    return BALDES_SECA - 1;
+}
+
+/* ============================================================= */
+/*  Função: imprimirAnalise()                                    */
+/*  detalhado = 0: uma linha (para resumos periódicos)          */
+/*  detalhado = 1: tabela por tipo + sequências                 */
+/* ============================================================= */
+void imprimirAnalise(const AnalisePecas *a, FILE *saida, int detalhado) {
+    double p;
+    double x = quiQuadrado(a, &p);
+    int tipoI = tipoDaLetra('I');
+    unsigned long long secaI = a->maiorSeca[tipoI];
+    if (a->ultimaPos[tipoI] != 0 && a->total - a->ultimaPos[tipoI] > secaI)
+        secaI = a->total - a->ultimaPos[tipoI];       // A seca de agora já é a maior
+    if (!detalhado) {
+        fprintf(saida, "peças %llu  qui² %.2f (p %.4f)  maior seca de I %llu  maior sequência %llu\n",
+                a->total, x, p, secaI, a->maiorSequencia > a->sequencia ? a->maiorSequencia : a->sequencia);
+        return;
+    }
+    fprintf(saida, "Peças    : %llu\n", a->total);
+    fprintf(saida, "Qui²     : %.3f (6 g.l., p = %.4f)\n", x, p);
+    fprintf(saida, "tipo   peças            freq   seca média  p50  p99  maior\n");
+    for (int t = 0; t < 7; t++) {
+        unsigned long long qtdSecas = 0;
+        for (int b = 0; b < BALDES_SECA; b++) qtdSecas += a->secas[t][b];
+        fprintf(saida, "  %c  %14llu  %6.3f%%   %10.2f  %3u  %3u  %5llu\n", tiposPeca[t], a->contagem[t],
+                a->total ? 100.0 * (double)a->contagem[t] / (double)a->total : 0.0,
+                qtdSecas ? (double)a->somaSecas[t] / (double)qtdSecas : 0.0,
+                percentilSeca(a, t, 0.5), percentilSeca(a, t, 0.99), a->maiorSeca[t]);
+    }
+    fprintf(saida, "Sequências do mesmo tipo (tamanho: quantas)\n ");
+    for (int b = 0; b < BALDES_SEQUENCIA; b++)
+        if (a->sequencias[b] > 0)
+            fprintf(saida, " %d%s: %llu", b + 1, b == BALDES_SEQUENCIA - 1 ? "+" : "", a->sequencias[b]);
+    fprintf(saida, "\n");
+    if (a->maiorSequencia > 0)
+        fprintf(saida, "Maior    : %llu × '%c' seguidas\n", a->maiorSequencia, tiposPeca[a->tipoMaiorSequencia]);
+}
+
+// Gera o próximo lote do produtor em "destino"
+static void produzirLote(AlimentadorPecas *a, LoteFeed *destino) {
+    gerarTiposEmLote(&a->gerador, destino->tipos, LOTE_PECAS);
+    memcpy(destino->s, a->gerador.s, sizeof destino->s);
+    memcpy(destino->saco, a->gerador.saco, sizeof destino->saco);
+    destino->posSaco = a->gerador.posSaco;
+}
+
+static void *rodarAlimentador(void *arg) {
+    AlimentadorPecas *a = arg;
+    LoteFeed descarte;                          // Lotes que o jogo já gerou sozinho
+    int ociosas = 0;
+    while (atomic_load_explicit(&a->rodando, memory_order_relaxed)) {
+        uint64_t cab = atomic_load_explicit(&a->cabeca, memory_order_relaxed);
+        uint64_t cau = atomic_load_explicit(&a->cauda, memory_order_acquire);
+        if (cab >= cau + ANEL_FEED) {
+            // Anel cheio: cede a vez; se continuar cheio, dorme um pouco
+            if (++ociosas < 64) sched_yield();
+            else nanosleep(&(struct timespec){ 0, 20000 }, NULL);
+            continue;
+        }
+        ociosas = 0;
+        // Atrás do jogo (ele teve faltas): o lote "cab" já foi usado, só
+        // falta avançar o gerador por ele. Senão, vai para a vaga dele.
+        produzirLote(a, cab < cau ? &descarte : &a->anel[cab & (ANEL_FEED - 1)]);
+        atomic_store_explicit(&a->cabeca, cab + 1, memory_order_release);
+    }
+    return NULL;
+}
+
+/* ============================================================= */
+/*  Função: ligarAlimentador()                                   */
+/*  Cria a thread produtora para o jogo (a partir do gerador    */
+/*  atual dele). Devolve 0 se não conseguir.                    */
+/* ============================================================= */
+int ligarAlimentador(Jogo *j) {
+    AlimentadorPecas *a = aligned_alloc(64, sizeof(AlimentadorPecas));
+    if (a == NULL) return 0;
+    memset(a, 0, sizeof *a);
+    atomic_init(&a->cabeca, 0);
+    atomic_init(&a->cauda, 0);
+    atomic_init(&a->rodando, 1);
+    a->gerador = j->gerador;
+    if (pthread_create(&a->thread, NULL, rodarAlimentador, a) != 0) { free(a); return 0; }
+    j->alimentador = a;
+    return 1;
+}
+
+/* ============================================================= */
+/*  Função: desligarAlimentador()                                */
+/*  Para a thread. Os lotes que sobraram no anel são jogados    */
+/*  fora: o gerador do jogo já está no ponto certo.             */
+/* ============================================================= */
+void desligarAlimentador(Jogo *j) {
+    AlimentadorPecas *a = j->alimentador;
+    if (a == NULL) return;
+    atomic_store(&a->rodando, 0);
+    pthread_join(a->thread, NULL);
+    free(a);
+    j->alimentador = NULL;
+}
+
+/* ============================================================= */
+/*  Função: receberLote()                                        */
+/*  Enche o lote do gerador do jogo com o próximo lote do anel  */
+/*  (ou gera na hora com o próprio gerador, se o anel estiver   */
+/*  vazio: nunca espera o produtor)                             */
+/* ============================================================= */
+static void receberLote(AlimentadorPecas *a, GeradorPecas *g) {
+    uint64_t cau = atomic_load_explicit(&a->cauda, memory_order_relaxed);
+    if (atomic_load_explicit(&a->cabeca, memory_order_acquire) > cau) {
+        const LoteFeed *lote = &a->anel[cau & (ANEL_FEED - 1)];
+        memcpy(g->lote, lote->tipos, LOTE_PECAS);
+        memcpy(g->s, lote->s, sizeof g->s);
+        memcpy(g->saco, lote->saco, sizeof g->saco);
+        g->posSaco = lote->posSaco;
+    } else {
+        gerarTiposEmLote(g, g->lote, LOTE_PECAS);   // Falta: o mesmo lote que o produtor faria
+        a->faltas++;
+    }
+    atomic_store_explicit(&a->cauda, cau + 1, memory_order_release);   // Libera a vaga (ou avisa o produtor atrasado)
+}
+
+/* ============================================================= */
+/*  Função: virarMetadeIds()                                     */
+/*  O contador de 32 bits acabou de passar por um múltiplo de   */
+/*  2^31: sobe a época se ele deu a volta e renumera as peças   */
+/*  vivas que já estão a 2^31 ou mais do contador (senão, mais  */
+/*  2^31 peças e idPeca() não saberia mais de que época são)    */
+/* ============================================================= */
+static void virarMetadeIds(Jogo *j) {
+    if (j->proximoId == 0) j->epocaId++;
+    for (int c = 0, i = j->frente; c < j->qtdFila; c++, i = (i + 1) & MASCARA_FILA)
+        if (j->proximoId - j->fila[i].id >= METADE_IDS) j->fila[i].id = j->proximoId++;
+    for (int i = 0; i < j->qtdPilha; i++)
+        if (j->proximoId - j->pilha[i].id >= METADE_IDS) j->pilha[i].id = j->proximoId++;
+}
+
+/* ============================================================= */
+/*  Função: gerarPeca()                                          */
+/*  Cria uma peça nova com letra aleatória e ID único           */
+/* ============================================================= */
+Peca gerarPeca(Jogo *j) {
+    GeradorPecas *g = &j->gerador;
+    if (g->posLote == LOTE_PECAS) {               // Lote acabou: gera mais LOTE_PECAS de uma vez
+        if (j->alimentador != NULL) receberLote(j->alimentador, g);   // ...ou pega um pronto
+        else gerarTiposEmLote(g, g->lote, LOTE_PECAS);
+        g->posLote = 0;
+        if (j->analise != NULL) analisarTipos(j->analise, g->lote, LOTE_PECAS);   // Auditoria, lote a lote
+    }
+    Peca p;                           // Crio uma peça temporária
+    p.nome = tiposPeca[g->lote[g->posLote++]];    // Pego o próximo tipo já sorteado
+    p.id   = j->proximoId++;          // Uso o próximo ID disponível e já aumento o contador
+    if ((j->proximoId & (METADE_IDS - 1)) == 0) virarMetadeIds(j);   // A cada 2^31 peças
+    return p;                         // Devolvo a peça pronta
+}
+
+/* ============================================================= */
+/*  Função: espiarTipos()                                        */
+/*  Diz quais serão os próximos n tipos (0 a 6) que o gerador   */
+/*  vai dar, sem mexer nele (trabalha numa cópia)               */
+/* ============================================================= */
+void espiarTipos(const GeradorPecas *g, unsigned char *destino, int n) {
+    GeradorPecas copia = *g;
+    for (int k = 0; k < n; k++) {
+        if (copia.posLote == LOTE_PECAS) {
+            gerarTiposEmLote(&copia, copia.lote, LOTE_PECAS);
+            copia.posLote = 0;
+        }
+        destino[k] = copia.lote[copia.posLote++];
+    }
+}
+
+/* ------------------- FORMAS DAS PEÇAS (tabuleiro) ----------- */
+typedef struct {
+    uint16_t linhas[4];               // Linhas da peça, a de baixo primeiro, encostada na coluna 0
+    uint8_t largura, altura;
+} FormaPeca;
+
+// As rotações de cada tipo (na ordem de tiposPeca), no sentido horário.
+// Rotações repetidas (a 'O' girada é a mesma 'O') não entram: a busca
+// de encaixe só testa formas diferentes.
+static const FormaPeca formas[7][4] = {
+    /* I */ { {{0xF, 0x0, 0x0, 0x0}, 4, 1}, {{0x1, 0x1, 0x1, 0x1}, 1, 4} },
+    /* O */ { {{0x3, 0x3, 0x0, 0x0}, 2, 2} },
+    /* T */ { {{0x7, 0x2, 0x0, 0x0}, 3, 2}, {{0x1, 0x3, 0x1, 0x0}, 2, 3},
+              {{0x2, 0x7, 0x0, 0x0}, 3, 2}, {{0x2, 0x3, 0x2, 0x0}, 2, 3} },
+    /* L */ { {{0x7, 0x4, 0x0, 0x0}, 3, 2}, {{0x3, 0x1, 0x1, 0x0}, 2, 3},
+              {{0x1, 0x7, 0x0, 0x0}, 3, 2}, {{0x2, 0x2, 0x3, 0x0}, 2, 3} },
+    /* J */ { {{0x7, 0x1, 0x0, 0x0}, 3, 2}, {{0x1, 0x1, 0x3, 0x0}, 2, 3},
+              {{0x4, 0x7, 0x0, 0x0}, 3, 2}, {{0x3, 0x2, 0x2, 0x0}, 2, 3} },
+    /* S */ { {{0x3, 0x6, 0x0, 0x0}, 3, 2}, {{0x2, 0x3, 0x1, 0x0}, 2, 3} },
+    /* Z */ { {{0x6, 0x3, 0x0, 0x0}, 3, 2}, {{0x1, 0x3, 0x2, 0x0}, 2, 3} },
+};
+static const int qtdRotacoes[7] = { 2, 1, 4, 4, 4, 2, 2 };
+static const unsigned pontosPorLinhas[5] = { 0, 40, 100, 300, 1200 };   // Pontuação clássica (nível 0)
+
+// As 4 linhas a partir de y como um uint64_t (memcpy: vale em qualquer
+// ordem de bytes, e o compilador troca por uma leitura só)
+static inline uint64_t lerLinhas(const Campo *c, int y) {
+    uint64_t v;
+    memcpy(&v, &c->linhas[y], sizeof v);
+    return v;
+}
+
+static inline uint64_t blocoDaForma(const FormaPeca *f, int coluna) {
+    uint64_t v;
+    memcpy(&v, f->linhas, sizeof v);
+    return v << coluna;               // Cada linha anda "coluna" bits; cabe nos 16 bits dela
+}
+
+/* ============================================================= */
+/*  Função: linhasCompletas()                                    */
+/*  Devolve uma máscara com o bit r ligado se a linha r está    */
+/*  completa                                                     */
+/* ============================================================= */
+uint32_t linhasCompletas(const Campo *c) {
+#if defined(__SSE2__)
+    const __m128i cheia = _mm_set1_epi16((short)CAMPO_CHEIO);
+    uint32_t mascara = 0;
+    for (int r = 0; r < LINHAS_CAMPO; r += 16) {
+        __m128i a = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)&c->linhas[r]), cheia);
+        __m128i b = _mm_cmpeq_epi16(_mm_loadu_si128((const __m128i *)&c->linhas[r + 8]), cheia);
+        // 16 resultados de 16 bits → 16 bytes → 1 bit cada
+        mascara |= (uint32_t)_mm_movemask_epi8(_mm_packs_epi16(a, b)) << r;
+    }
+    return mascara;
+#else
+    uint32_t mascara = 0;
+    for (int r = 0; r < c->altura; r++) mascara |= (uint32_t)(c->linhas[r] == CAMPO_CHEIO) << r;
+    return mascara;
+#endif
+}
+
+/* ============================================================= */
+/*  Função: limparCampo()                                        */
+/* ============================================================= */
+void limparCampo(Campo *c) {
+    memset(c, 0, sizeof *c);
+}
+
+/* ============================================================= */
+/*  Função: soltarPeca()                                         */
+/*  Deixa a peça "tipo" (0 a 6), na rotação e coluna pedidas,   */
+/*  cair até encostar. Apaga as linhas completas e soma os      */
+/*  pontos. Se o campo passar do topo, conta uma derrota e      */
+/*  recomeça vazio. Devolve quantas linhas apagou, ou -1 se a   */
+/*  rotação/coluna não existem.                                  */
+/* ============================================================= */
+int soltarPeca(Campo *c, int tipo, int rotacao, int coluna) {
+    if (rotacao < 0 || rotacao >= qtdRotacoes[tipo]) return -1;
+    const FormaPeca *f = &formas[tipo][rotacao];
+    if (coluna < 0 || coluna + f->largura > LARGURA_TAB) return -1;
+
+    uint64_t peca = blocoDaForma(f, coluna);
+    int y = c->altura;                            // Acima da linha mais alta nada pode colidir
+    while (y > 0 && (lerLinhas(c, y - 1) & peca) == 0) y--;
+    uint64_t junto = lerLinhas(c, y) | peca;      // Pousa as 4 linhas de uma vez
+    memcpy(&c->linhas[y], &junto, sizeof junto);
+    if (y + f->altura > c->altura) c->altura = y + f->altura;
+    c->pecas++;
+
+    int feitas = 0;
+    uint32_t completas = linhasCompletas(c);
+    if (completas != 0) {                         // Apaga e puxa as de cima para baixo
+        int destino = 0;
+        for (int r = 0; r < c->altura; r++)
+            if (!((completas >> r) & 1)) c->linhas[destino++] = c->linhas[r];
+        feitas = c->altura - destino;
+        memset(&c->linhas[destino], 0, (size_t)feitas * sizeof c->linhas[0]);
+        c->altura = destino;
+        c->linhasFeitas += (unsigned)feitas;
+        c->pontos += pontosPorLinhas[feitas];
+    }
+    if (c->altura > ALTURA_TAB) {                 // Passou do topo: fim dessa partida
+        memset(c->linhas, 0, sizeof c->linhas);
+        c->altura = 0;
+        c->derrotas++;
+    }
+    return feitas;
+}
+
+/* ============================================================= */
+/*  Função: avaliarCampo()                                       */
+/*  Nota de um campo (quanto maior, melhor): pesos de uma       */
+/*  heurística clássica para altura somada, buracos (casas      */
+/*  vazias com bloco em cima) e irregularidade (diferença de    */
+/*  altura entre colunas vizinhas). Tudo linha a linha, com     */
+/*  operações de bits.                                           */
+/* ============================================================= */
+int avaliarCampo(const Campo *c) {
+    int alturaColuna[LARGURA_TAB] = {0};
+    unsigned acima = 0;                           // Colunas que já têm bloco em alguma linha de cima
+    int buracos = 0;
+    for (int r = c->altura - 1; r >= 0; r--) {
+        unsigned linha = c->linhas[r];
+        buracos += __builtin_popcount(acima & ~linha);
+        for (unsigned novas = linha & ~acima; novas != 0; novas &= novas - 1)
+            alturaColuna[__builtin_ctz(novas)] = r + 1;   // Primeiro bloco da coluna, vindo de cima
+        acima |= linha;
+    }
+    int soma = 0, irregular = 0;
+    for (int col = 0; col < LARGURA_TAB; col++) {
+        soma += alturaColuna[col];
+        if (col > 0) irregular += abs(alturaColuna[col] - alturaColuna[col - 1]);
+    }
+    return -51 * soma - 36 * buracos - 18 * irregular;
+}
+
+/* ============================================================= */
+/*  Função: escolherEncaixe()                                    */
+/*  Testa todas as rotações e colunas de "tipo" numa cópia do   */
+/*  campo e diz qual deixa a melhor nota                         */
+/* ============================================================= */
+void escolherEncaixe(const Campo *c, int tipo, int *rotacao, int *coluna) {
+    int melhor = 0, achou = 0;
+    *rotacao = 0; *coluna = 0;
+    for (int r = 0; r < qtdRotacoes[tipo]; r++) {
+        for (int col = 0; col + formas[tipo][r].largura <= LARGURA_TAB; col++) {
+            Campo teste = *c;
+            int feitas = soltarPeca(&teste, tipo, r, col);
+            int nota = teste.derrotas != c->derrotas ? INT32_MIN / 2   // Perde a partida: só em último caso
+                                                     : 76 * feitas + avaliarCampo(&teste);
+            if (!achou || nota > melhor) { melhor = nota; *rotacao = r; *coluna = col; achou = 1; }
+        }
+    }
+}
+
+/* ============================================================= */
+/*  Função: ligarTabuleiro()                                     */
+/*  Dá ao jogo um tabuleiro vazio. Devolve 0 se faltar memória. */
+/* ============================================================= */
+int ligarTabuleiro(Jogo *j) {
+    // calloc, não malloc: as fotos ainda não tiradas e o buraco antes
+    // de fotos[] vão inteiros para o snapshot, e têm que sair sempre 0
+    Tabuleiro *t = calloc(1, sizeof(Tabuleiro));
+    if (t == NULL) return 0;
+    limparCampo(&t->campo);
+    t->cursor = 0;
+    t->qtdVoltar = t->qtdAvancar = 0;
+    j->tabuleiro = t;
+    return 1;
+}
+
+void desligarTabuleiro(Jogo *j) {
+    free(j->tabuleiro);
+    j->tabuleiro = NULL;
+}
+
+/* ============================================================= */
+/*  Função: pousarPeca()                                         */
+/*  Guarda a foto do campo (para o desfazer) e deixa a peça     */
+/*  cair no melhor encaixe ("falar" = 0: sem mensagem)           */
+/* ============================================================= */
+static inline void pousarPeca(Jogo *j, Peca p, int falar) {
+    Tabuleiro *t = j->tabuleiro;
+    t->fotos[t->cursor & (FOTOS_TABULEIRO - 1)] = t->campo;
+    t->cursor++;
+    if (t->qtdVoltar < FOTOS_TABULEIRO) t->qtdVoltar++;
+    t->qtdAvancar = 0;
+
+    int tipo = tipoDaLetra(p.nome), rotacao, coluna;
+    escolherEncaixe(&t->campo, tipo, &rotacao, &coluna);
+    int feitas = soltarPeca(&t->campo, tipo, rotacao, coluna);
+    if (!falar) return;
+    unsigned long long id = idPeca(j, p);
+    if (feitas > 0) MSG("  [%c %llu] caiu na coluna %d: %d linha(s)!\n", p.nome, id, coluna + 1, feitas);
+    else MSG("  [%c %llu] caiu na coluna %d\n", p.nome, id, coluna + 1);
+}
+
+// Desfazer/refazer de "n" pousos: troca o campo atual com a foto,
+// então a foto passa a guardar o lado que acabou de sair
+static void voltarTabuleiro(Tabuleiro *t, int n) {
+    for (; n > 0 && t->qtdVoltar > 0; n--) {
+        t->cursor--;
+        Campo *foto = &t->fotos[t->cursor & (FOTOS_TABULEIRO - 1)];
+        Campo atual = t->campo; t->campo = *foto; *foto = atual;
+        t->qtdVoltar--; t->qtdAvancar++;
+    }
+}
+
+static void avancarTabuleiro(Tabuleiro *t, int n) {
+    for (; n > 0 && t->qtdAvancar > 0; n--) {
+        Campo *foto = &t->fotos[t->cursor & (FOTOS_TABULEIRO - 1)];
+        Campo atual = t->campo; t->campo = *foto; *foto = atual;
+        t->cursor++;
+        t->qtdAvancar--; t->qtdVoltar++;
+    }
+}
+
+/* ============================================================= */
+/*  Função: salvarEstado()                                       */
+/*  Tira uma "foto" do jogo antes de uma ação                   */
+/* ============================================================= */
+void salvarEstado(const Jogo *j, Estado *foto) {
+    // Salva a fila inteira
+    for (int i = 0; i < ARMAZ_FILA; i++)
+        foto->fila_salva[i] = j->fila[i];
+
+    // Salva os índices e quantidade da fila
+    foto->frente_salvo  = j->frente;
+    foto->tras_salvo    = j->tras;
+    foto->qtdFila_salvo = j->qtdFila;
+
+    // Salva a pilha inteira
+    for (int i = 0; i < TAM_PILHA; i++)
+        foto->pilha_salva[i] = j->pilha[i];
+
+    // Salva os índices e quantidade da pilha
+    foto->topo_salvo     = j->topo;
+    foto->qtdPilha_salvo = j->qtdPilha;
+
+    // Só o contador de pousos: o tabuleiro guarda as fotos dele
+    foto->pousos_salvo = j->tabuleiro != NULL ? j->tabuleiro->cursor : 0;
+}
+
+/* ------------------- Funções auxiliares da arena ------------ */
+// Lê um byte na posição "pos" da arena (dá a volta sozinho)
+static inline unsigned char lerByteLog(const LogDesfazer *h, size_t pos) {
+    return h->dados[pos & (h->capacidade - 1)];
+}
+
+// Copia "n" bytes da arena a partir de "pos" para "destino" (no máximo
+// dois memcpy: até o fim do buffer e, se precisar, do começo)
+static void lerBytesLog(const LogDesfazer *h, size_t pos, unsigned char *destino, size_t n) {
+    size_t fisico = pos & (h->capacidade - 1);
+    size_t ateFim = h->capacidade - fisico;
+    if (n <= ateFim) memcpy(destino, h->dados + fisico, n);
+    else {
+        memcpy(destino, h->dados + fisico, ateFim);
+        memcpy(destino + ateFim, h->dados, n - ateFim);
+    }
+}
+static void escreverBytesLog(LogDesfazer *h, size_t pos, const unsigned char *origem, size_t n) {
+    size_t fisico = pos & (h->capacidade - 1);
+    size_t ateFim = h->capacidade - fisico;
+    if (n <= ateFim) memcpy(h->dados + fisico, origem, n);
+    else {
+        memcpy(h->dados + fisico, origem, ateFim);
+        memcpy(h->dados, origem + ateFim, n - ateFim);
+    }
+}
+
+// Uma peça vira 5 bytes: a letra e o id em little-endian
+static void escreverPecaLog(unsigned char *destino, Peca p) {
+    destino[0] = (unsigned char)p.nome;
+    for (int b = 0; b < 4; b++) destino[1 + b] = (unsigned char)(p.id >> (8 * b));
+}
+static Peca lerPecaLog(const unsigned char *origem) {
+    Peca p;
+    p.nome = (char)origem[0];
+    p.id = 0;
+    for (int b = 0; b < 4; b++) p.id |= (uint32_t)origem[1 + b] << (8 * b);
+    return p;
+}
+
+/* ============================================================= */
+/*  Função: reservarEspacoLog()                                  */
+/*  Garante "n" bytes livres no fim do histórico: primeiro      */
+/*  tenta crescer a arena, depois descarta os mais antigos      */
+/*  Devolve 0 se não couber de jeito nenhum                     */
+/* ============================================================= */
+static int reservarEspacoLog(LogDesfazer *h, size_t n) {
+    if (h->dados == NULL) {                       // Primeira ação: cria a arena
+        size_t cap = CAPACIDADE_INICIAL_LOG;
+        while (cap > h->orcamento && cap > 1) cap /= 2;
+        h->dados = malloc(cap);
+        if (h->dados == NULL) return 0;
+        h->capacidade = cap;
+    }
+    while (h->fim - h->inicio + n > h->capacidade) {
+        if (h->capacidade * 2 <= h->orcamento) {  // Ainda dá para crescer: dobra a arena
+            size_t novaCap = h->capacidade * 2;
+            unsigned char *novo = malloc(novaCap);
+            if (novo != NULL) {
+                for (size_t pos = h->inicio; pos < h->fim; pos++)
+                    novo[pos & (novaCap - 1)] = lerByteLog(h, pos);   // Mesmas posições lógicas
+                free(h->dados);
+                h->dados = novo;
+                h->capacidade = novaCap;
+                continue;
+            }
+        }
+        if (h->qtdDesfazer == 0) return 0;        // Nada mais para descartar: não cabe
+        h->inicio += lerByteLog(h, h->inicio);    // Descarta o registro mais antigo
+        h->qtdDesfazer--;
+    }
+    return 1;
+}
+
+/* ============================================================= */
+/*  Função: aplicarRegistro()                                    */
+/*  Coloca no jogo o lado "antes" (lado = 0) ou o lado "depois" */
+/*  (lado = 1) do registro que começa em "pos" do histórico "h" */
+/*  (o do próprio jogo ou o de um Ramo)                          */
+/* ============================================================= */
+static void aplicarRegistro(Jogo *j, const LogDesfazer *h, size_t pos, int lado) {
+    unsigned char reg[MAX_REGISTRO];
+    lerBytesLog(h, pos, reg, lerByteLog(h, pos));    // Traz o registro inteiro de uma vez
+
+    const unsigned char *r = reg + 1 + (lado ? BYTES_INDICES : 0);
+    j->frente   = r[0];
+    j->tras     = r[1];
+    j->qtdFila  = r[2];
+    j->topo     = (int8_t)(r[3] - 1);
+    j->qtdPilha = r[4];
+
+    r = reg + 1 + 2 * BYTES_INDICES;
+    int n = *r++;
+    for (int k = 0; k < n; k++, r += BYTES_SLOT) {
+        int i = r[0];
+        if (i == POS_TABULEIRO) {                     // Pousos no tabuleiro: volta ou avança as fotos
+            if (j->tabuleiro == NULL) continue;
+            if (lado) avancarTabuleiro(j->tabuleiro, r[1]);
+            else voltarTabuleiro(j->tabuleiro, r[1]);
+            continue;
+        }
+        Peca peca = lerPecaLog(r + 1 + (lado ? BYTES_PECA : 0));
+        if (i < ARMAZ_FILA) j->fila[i] = peca;
+        else j->pilha[i - ARMAZ_FILA] = peca;
+    }
+}
+
+/* ============================================================= */
+/*  RAMOS (bifurcar uma sessão sem copiar o histórico)           */
+/* ============================================================= */
+// bifurcarJogo() cria uma cópia do jogo que segue por conta própria
+// ("e se eu tivesse jogado outra coisa aqui?"). Copiar a parte quente
+// e o gerador é barato; o caro seria copiar o histórico do desfazer.
+// Então o histórico vira uma cadeia de pedaços congelados:
+//
+//   - na bifurcação, a arena do jogo de origem é "congelada" num Ramo
+//     (só muda de dono, nada é copiado) e os dois jogos começam uma
+//     arena nova e vazia, apontando para esse Ramo e para o ponto
+//     (cursor) onde pararam nele
+//   - um Ramo nunca mais muda: pode ser lido por quantos jogos (e
+//     threads) quiserem. Quem aponta para ele soma 1 em "refs"; o
+//     último a soltar libera a memória
+//   - desfazer, quando a arena do jogo acaba, continua no Ramo de
+//     cima, e dele para o de cima dele; refazer faz o caminho de volta
+//   - uma ação nova feita "lá em cima" (depois de desfazer para dentro
+//     de um Ramo) ancora o jogo naquele ponto e esvazia a arena dele
+//     (é o "ação nova apaga o que dava para refazer" de sempre)
+//
+// Bifurcar custa O(1) (um Ramo pequeno e uma cópia de ~200 bytes) e
+// mil ramos de uma sessão dividem o mesmo histórico até o ponto em que
+// se separaram. O orçamento do desfazer vale para a arena própria de
+// cada jogo; se ela já descartou registros antigos, o desfazer para
+// ali (os registros que ligariam ao Ramo de cima foram perdidos).
+typedef struct Ramo {
+    _Atomic int refs;                 // Jogos e Ramos de baixo que apontam para este
+    struct Ramo *anterior;            // O Ramo de onde este saiu (NULL = começo da partida)
+    size_t pontoAnterior;             // Onde, no anterior, este começa
+    LogDesfazer log;                  // A arena congelada (só leitura)
+} Ramo;
+
+static void soltarRamo(Ramo *r) {
+    while (r != NULL && atomic_fetch_sub(&r->refs, 1) == 1) {   // Era o último: libera e sobe
+        Ramo *anterior = r->anterior;
+        free(r->log.dados);
+        free(r);
+        r = anterior;
+    }
+}
+
+// Esvazia a arena própria do jogo (mantendo a memória dela)
+static void esvaziarLog(LogDesfazer *h) {
+    h->inicio = h->cursor = h->fim = 0;
+    h->qtdDesfazer = h->qtdRefazer = 0;
+}
+
+/* ============================================================= */
+/*  Função: ancorarRamo()                                        */
+/*  Chamada antes de registrar uma ação nova. Se o jogo estava  */
+/*  "dentro" de um Ramo (desfez até lá), ele passa a continuar  */
+/*  daquele ponto: a arena própria (só tinha o que refazer) é   */
+/*  esvaziada.                                                   */
+/* ============================================================= */
+static void ancorarRamo(Jogo *j) {
+    Ramo *r = j->ramoAtual;
+    atomic_fetch_add(&r->refs, 1);                 // Pega antes de soltar: r pode ser o próprio j->ramo
+    soltarRamo(j->ramo);
+    j->ramo = r;
+    j->pontoRamo = j->cursorRamo;
+    j->ramoAtual = NULL;
+    esvaziarLog(&j->historico);
+}
+
+// Quantos pousos o registro que começa em "pos" desfez/refaz no
+// tabuleiro (o slot POS_TABULEIRO, quando tem, é sempre o último)
+static int pousosDoRegistro(const LogDesfazer *h, size_t pos) {
+    size_t inicioSlots = pos + 1 + 2 * BYTES_INDICES;
+    int n = lerByteLog(h, inicioSlots);
+    if (n == 0) return 0;
+    size_t ultimo = inicioSlots + 1 + (size_t)(n - 1) * BYTES_SLOT;
+    return lerByteLog(h, ultimo) == POS_TABULEIRO ? lerByteLog(h, ultimo + 1) : 0;
+}
+
+// O tabuleiro ainda tem as fotos para voltar os pousos desse registro?
+// Sem elas, desfazer só a fila e a reserva deixaria o jogo torto: o
+// desfazer para ali (RESULTADO_SEM_FOTO).
+static inline int tabuleiroAcompanha(const Jogo *j, const LogDesfazer *h, size_t pos) {
+    return j->tabuleiro == NULL || pousosDoRegistro(h, pos) <= j->tabuleiro->qtdVoltar;
+}
+
+// Desfaz um registro de dentro dos Ramos. Devolve RESULTADO_OK,
+// RESULTADO_NADA_DESFAZER ou RESULTADO_SEM_FOTO.
+static int desfazerNoRamo(Jogo *j) {
+    Ramo *r;
+    size_t cur;
+    if (j->ramoAtual != NULL) { r = j->ramoAtual; cur = j->cursorRamo; }
+    else {
+        if (j->historico.inicio != 0) return RESULTADO_NADA_DESFAZER;    // A arena própria já perdeu o começo
+        r = j->ramo; cur = j->pontoRamo;
+    }
+    while (r != NULL && cur == r->log.inicio) {    // Começo deste Ramo: sobe para o anterior
+        if (r->log.inicio != 0) return RESULTADO_NADA_DESFAZER;
+        cur = r->pontoAnterior;
+        r = r->anterior;
+    }
+    if (r == NULL) return RESULTADO_NADA_DESFAZER;
+    cur -= lerByteLog(&r->log, cur - 1);
+    if (!tabuleiroAcompanha(j, &r->log, cur)) return RESULTADO_SEM_FOTO;
+    aplicarRegistro(j, &r->log, cur, 0);
+    j->ramoAtual = r;
+    j->cursorRamo = cur;
+    return RESULTADO_OK;
+}
+
+// Refaz um registro de dentro dos Ramos (o jogo está em j->ramoAtual).
+// O caminho de volta é achado subindo a partir de j->ramo: só é preciso
+// quando o refazer passa de um Ramo para o de baixo.
+static int refazerNoRamo(Jogo *j) {
+    Ramo *r = j->ramoAtual;
+    size_t cur = j->cursorRamo;
+    for (;;) {
+        Ramo *filho = NULL;
+        size_t limite = j->pontoRamo;
+        if (r != j->ramo) {
+            for (filho = j->ramo; filho->anterior != r; filho = filho->anterior) { }
+            limite = filho->pontoAnterior;
+        }
+        if (cur < limite) break;
+        if (filho == NULL) {                       // Acabaram os Ramos: volta para a arena própria
+            j->ramoAtual = NULL;
+            if (j->historico.qtdRefazer == 0) return 0;
+            LogDesfazer *h = &j->historico;
+            aplicarRegistro(j, h, h->cursor, 1);
+            h->cursor += lerByteLog(h, h->cursor);
+            h->qtdRefazer--;
+            h->qtdDesfazer++;
+            return 1;
+        }
+        r = filho;
+        cur = filho->log.inicio;
+    }
+    aplicarRegistro(j, &r->log, cur, 1);
+    j->ramoAtual = r;
+    j->cursorRamo = cur + lerByteLog(&r->log, cur);
+    return 1;
+}
+
+/* ============================================================= */
+/*  Função: bifurcarJogo()                                       */
+/*  Faz de "novo" um ramo de "origem": mesmo estado, mesmo      */
+/*  gerador (as mesmas próximas peças) e o mesmo histórico para */
+/*  desfazer, sem copiar o histórico. O refazer pendente fica   */
+/*  só com a origem (o ramo começa sem). Com tabuleiro, o ramo  */
+/*  ganha uma cópia do campo (o desfazer do tabuleiro do ramo   */
+/*  começa na bifurcação). Devolve 0 se faltar memória.         */
+/* ============================================================= */
+int bifurcarJogo(Jogo *novo, Jogo *origem) {
+    Ramo *r;
+    size_t ponto;
+    LogDesfazer *h = &origem->historico;
+    if (origem->ramoAtual != NULL) {               // Origem está dentro de um Ramo: o ponto já existe
+        r = origem->ramoAtual;
+        ponto = origem->cursorRamo;
+    } else if (h->cursor == h->inicio && h->inicio == 0) {   // Arena própria vazia: divide o mesmo Ramo
+        r = origem->ramo;
+        ponto = origem->pontoRamo;
+    } else {                                       // Congela a arena da origem num Ramo novo
+        r = malloc(sizeof(Ramo));
+        if (r == NULL) return 0;
+        atomic_init(&r->refs, 1);                  // A origem
+        r->anterior = origem->ramo;                // A referência da origem passa para o Ramo
+        r->pontoAnterior = origem->pontoRamo;
+        r->log = *h;
+        ponto = h->cursor;
+        origem->ramo = r;
+        origem->pontoRamo = h->fim;                // A origem continua podendo refazer o que tinha...
+        if (h->cursor != h->fim) {                 // ...agora de dentro do Ramo
+            origem->ramoAtual = r;
+            origem->cursorRamo = ponto;
+        }
+        h->dados = NULL;                           // A origem começa uma arena nova (criada na próxima ação)
+        h->capacidade = 0;
+        esvaziarLog(h);
+    }
+
+    memcpy(novo, origem, offsetof(Jogo, historico));   // Parte quente + gerador
+    memset(&novo->historico, 0, sizeof novo->historico);
+    novo->historico.orcamento = h->orcamento;
+    novo->alimentador = NULL;                      // O gerador copiado já está no ponto certo
+    novo->tabuleiro = NULL;
+    novo->analise = NULL;                          // As peças de um ramo não entram na auditoria
+    novo->ramo = r;
+    novo->pontoRamo = ponto;
+    novo->ramoAtual = NULL;
+    novo->cursorRamo = 0;
+    if (r != NULL) atomic_fetch_add(&r->refs, 1);
+    if (origem->tabuleiro != NULL) {
+        if (!ligarTabuleiro(novo)) { soltarRamo(novo->ramo); novo->ramo = NULL; return 0; }
+        novo->tabuleiro->campo = origem->tabuleiro->campo;
+    }
+    return 1;
+}
+
+/* ============================================================= */
+/*  Função: registrarDelta()                                     */
+/*  Compara o jogo com a foto de antes e grava no histórico só  */
+/*  as posições e índices que mudaram. Ação que não mudou nada  */
+/*  (ex.: "Reserva cheia!") não ocupa o histórico.              */
+/* ============================================================= */
+void registrarDelta(Jogo *j, const Estado *antes) {
+    unsigned char posicoes[ARMAZ_FILA + TAM_PILHA + 1];   // Quais posições mudaram
+    int n = 0;
+    for (int i = 0; i < ARMAZ_FILA; i++)
+        if (j->fila[i].nome != antes->fila_salva[i].nome || j->fila[i].id != antes->fila_salva[i].id)
+            posicoes[n++] = (unsigned char)i;
+    for (int i = 0; i < TAM_PILHA; i++)
+        if (j->pilha[i].nome != antes->pilha_salva[i].nome || j->pilha[i].id != antes->pilha_salva[i].id)
+            posicoes[n++] = (unsigned char)(ARMAZ_FILA + i);
+    int pousos = j->tabuleiro != NULL ? (int)(j->tabuleiro->cursor - antes->pousos_salvo) : 0;
+    if (pousos > 0) posicoes[n++] = POS_TABULEIRO;
+
+    unsigned char indicesAntes[BYTES_INDICES] = {
+        (unsigned char)antes->frente_salvo, (unsigned char)antes->tras_salvo,
+        (unsigned char)antes->qtdFila_salvo, (unsigned char)(antes->topo_salvo + 1),
+        (unsigned char)antes->qtdPilha_salvo };
+    unsigned char indicesDepois[BYTES_INDICES] = {
+        j->frente, j->tras, j->qtdFila, (unsigned char)(j->topo + 1), j->qtdPilha };
+
+    int mudouIndice = 0;
+    for (int b = 0; b < BYTES_INDICES; b++) mudouIndice |= indicesAntes[b] != indicesDepois[b];
+    if (n == 0 && !mudouIndice) return;               // Nada mudou → nada a registrar
+
+    if (j->ramoAtual != NULL) ancorarRamo(j);         // Ação nova depois de desfazer para dentro de um Ramo
+    LogDesfazer *h = &j->historico;
+    h->fim = h->cursor;                               // Ação nova apaga o que dava para refazer
+    h->qtdRefazer = 0;
+    if (j->tabuleiro != NULL) j->tabuleiro->qtdAvancar = 0;
+
+    size_t tam = 2 + 2 * BYTES_INDICES + 1 + (size_t)n * BYTES_SLOT;
+    if (!reservarEspacoLog(h, tam)) {                 // Orçamento menor que um registro:
+        h->inicio = h->cursor = h->fim;               // o histórico fica vazio
+        h->qtdDesfazer = 0;
+        return;
+    }
+
+    unsigned char reg[MAX_REGISTRO];                  // Monta o registro aqui e copia de uma vez
+    unsigned char *r = reg;
+    *r++ = (unsigned char)tam;
+    memcpy(r, indicesAntes, BYTES_INDICES);  r += BYTES_INDICES;
+    memcpy(r, indicesDepois, BYTES_INDICES); r += BYTES_INDICES;
+    *r++ = (unsigned char)n;
+    for (int k = 0; k < n; k++) {
+        int i = posicoes[k];
+        *r = (unsigned char)i;
+        if (i == POS_TABULEIRO) {
+            memset(r + 1, 0, 2 * BYTES_PECA);
+            r[1] = (unsigned char)pousos;
+        } else if (i < ARMAZ_FILA) {
+            escreverPecaLog(r + 1, antes->fila_salva[i]);
+            escreverPecaLog(r + 1 + BYTES_PECA, j->fila[i]);
+        } else {
+            escreverPecaLog(r + 1, antes->pilha_salva[i - ARMAZ_FILA]);
+            escreverPecaLog(r + 1 + BYTES_PECA, j->pilha[i - ARMAZ_FILA]);
+        }
+        r += BYTES_SLOT;
+    }
+    *r = (unsigned char)tam;
+    escreverBytesLog(h, h->fim, reg, tam);
+
+    h->cursor = h->fim = h->fim + tam;
+    h->qtdDesfazer++;
+}
+
+/* ------------------- Ações com e sem mensagem ---------------- */
+// Cada ação é um "núcleo" static inline com um parâmetro "falar". As
+// funções do menu (jogarPeca, desfazer...) chamam com falar = 1; o
+// aplicarAcoes() chama com falar = 0, e como o valor é uma constante o
+// compilador apaga as mensagens inteiras desse caminho: nem o teste do
+// modoSilencioso sobra.
+#define FALAR(...) do { if (falar) MSG(__VA_ARGS__); } while (0)
+
+/* ============================================================= */
+/*  Função: desfazer()                                           */
+/*  Volta para o estado anterior (UNDO)                          */
+/* ============================================================= */
+static inline int nucleoDesfazer(Jogo *j, int falar) {
+    LogDesfazer *h = &j->historico;
+    if (h->qtdDesfazer == 0) {        // Se não tem nenhuma ação para voltar
+        // ...aqui; mas pode ter no Ramo de onde este jogo saiu
+        int r = j->ramo != NULL ? desfazerNoRamo(j) : RESULTADO_NADA_DESFAZER;
+        if (r == RESULTADO_OK) FALAR("  Última ação desfeita!\n");
+        else if (r == RESULTADO_SEM_FOTO) FALAR("  O tabuleiro não volta mais que isso!\n");
+        else FALAR("  Nada para desfazer!\n");
+        return r;
+    }
+    size_t tam = lerByteLog(h, h->cursor - 1);        // O tamanho também está no fim do registro
+    if (!tabuleiroAcompanha(j, h, h->cursor - tam)) {
+        FALAR("  O tabuleiro não volta mais que isso!\n");
+        return RESULTADO_SEM_FOTO;
+    }
+    h->cursor -= tam;
+    aplicarRegistro(j, h, h->cursor, 0);              // Restaura o lado "antes"
+    h->qtdDesfazer--;
+    h->qtdRefazer++;
+
+    FALAR("  Última ação desfeita!\n");
+    return RESULTADO_OK;
+}
+
+int desfazer(Jogo *j) { return nucleoDesfazer(j, 1); }
+
+/* ============================================================= */
+/*  Função: refazer()                                            */
+/*  Refaz a última ação desfeita (REDO)                          */
+/* ============================================================= */
+static inline int nucleoRefazer(Jogo *j, int falar) {
+    LogDesfazer *h = &j->historico;
+    if (j->ramoAtual != NULL) {       // Desfez para dentro de um Ramo: refaz de lá
+        if (refazerNoRamo(j)) { FALAR("  Ação refeita!\n"); return RESULTADO_OK; }
+        FALAR("  Nada para refazer!\n");
+        return RESULTADO_NADA_REFAZER;
+    }
+    if (h->qtdRefazer == 0) {
+        FALAR("  Nada para refazer!\n");
+        return RESULTADO_NADA_REFAZER;
+    }
+    aplicarRegistro(j, h, h->cursor, 1);              // Restaura o lado "depois"
+    h->cursor += lerByteLog(h, h->cursor);
+    h->qtdRefazer--;
+    h->qtdDesfazer++;
+
+    FALAR("  Ação refeita!\n");
+    return RESULTADO_OK;
+}
+
+int refazer(Jogo *j) { return nucleoRefazer(j, 1); }
+
+/* ============================================================= */
+/*  Função: enqueue()                                            */
+/*  Adiciona uma peça nova no final da fila (circular)          */
+/* ============================================================= */
+void enqueue(Jogo *j) {
+    if (j->qtdFila < TAM_FILA) {      // Só adiciona se tiver espaço
+        Peca nova = gerarPeca(j);     // Cria peça nova
+        j->fila[j->tras] = nova;      // Coloca na posição "tras"
+        j->tras = (j->tras + 1) & MASCARA_FILA;   // Avança circularmente (ex: 7+1 → 0)
+        j->qtdFila++;                 // Aumenta quantidade
+    }
+}
+
+/* ============================================================= */
+/*  Função: dequeue()                                            */
+/*  Remove e devolve a peça da frente da fila                   */
+/* ============================================================= */
+Peca dequeue(Jogo *j) {
+    Peca p = j->fila[j->frente];      // Pega a peça da frente
+    j->frente = (j->frente + 1) & MASCARA_FILA;   // Avança o ponteiro da frente
+    j->qtdFila--;                     // Diminui quantidade
+    return p;                         // Devolve a peça removida
+}
+
+/* ============================================================= */
+/*  Opção 1 – Jogar peça normal                                  */
+/* ============================================================= */
+static inline int nucleoJogar(Jogo *j, int falar, Peca *jogada) {
+    if (j->qtdFila == 0) { FALAR("  Fila vazia!\n"); return RESULTADO_FILA_VAZIA; }
+    *jogada = dequeue(j);             // Remove da frente
+    FALAR("  Jogou peça [%c %llu]\n", jogada->nome, (unsigned long long)idPeca(j, *jogada));
+    if (j->tabuleiro != NULL) pousarPeca(j, *jogada, falar);   // Cai no tabuleiro
+    enqueue(j);                       // Gera nova peça → fila volta a ter 5
+    return RESULTADO_OK;
+}
+
+int jogarPeca(Jogo *j) { Peca jogada; return nucleoJogar(j, 1, &jogada); }
+
+/* ============================================================= */
+/*  Opção 2 – Reservar peça (Hold)                               */
+/* ============================================================= */
+static inline int nucleoReservar(Jogo *j, int falar) {
+    if (j->qtdFila == 0) { FALAR("  Fila vazia!\n"); return RESULTADO_FILA_VAZIA; }
+    if (j->qtdPilha >= TAM_PILHA) { FALAR("  Reserva cheia!\n"); return RESULTADO_RESERVA_CHEIA; }
+
+    Peca p = dequeue(j);              // Tira da frente da fila
+    j->topo++; j->pilha[j->topo] = p; j->qtdPilha++;  // Empilha
+    FALAR("  Reservou [%c %llu]\n", p.nome, (unsigned long long)idPeca(j, p));
+    enqueue(j);                       // Repõe na fila
+    return RESULTADO_OK;
+}
+
+int reservarPeca(Jogo *j) { return nucleoReservar(j, 1); }
+
+/* ============================================================= */
+/*  Opção 3 – Usar peça reservada                                */
+/* ============================================================= */
+// Joga duas peças: jogadas[0] recebe a reservada, jogadas[1] a da frente
+static inline int nucleoUsar(Jogo *j, int falar, Peca *jogadas) {
+    if (j->qtdPilha == 0) { FALAR("  Reserva vazia!\n"); return RESULTADO_RESERVA_VAZIA; }
+    if (j->qtdFila == 0) { FALAR("  Fila vazia!\n"); return RESULTADO_FILA_VAZIA; }
+
+    Peca usada = j->pilha[j->topo]; j->topo--; j->qtdPilha--;  // Desempilha
+    FALAR("  Usou reservada [%c %llu]\n", usada.nome, (unsigned long long)idPeca(j, usada));
+    if (j->tabuleiro != NULL) pousarPeca(j, usada, falar);
+
+    Peca jogada = dequeue(j);         // Joga a peça que estava na frente
+    FALAR("  Jogou da fila [%c %llu]\n", jogada.nome, (unsigned long long)idPeca(j, jogada));
+    if (j->tabuleiro != NULL) pousarPeca(j, jogada, falar);
+    enqueue(j);
+    jogadas[0] = usada;
+    jogadas[1] = jogada;
+    return RESULTADO_OK;
+}
+
+int usarReservada(Jogo *j) { Peca jogadas[2]; return nucleoUsar(j, 1, jogadas); }
+
+/* ============================================================= */
+/*  Opção 4 – Trocar topo da pilha com frente da fila           */
+/* ============================================================= */
+static inline int nucleoTrocar(Jogo *j, int falar) {
+    if (j->qtdFila == 0 || j->qtdPilha == 0) {
+        FALAR("  Não é possível trocar: uma das estruturas está vazia!\n");
+        return RESULTADO_TROCA_IMPOSSIVEL;
+    }
+    Peca temp = j->pilha[j->topo];    // Guarda temporariamente a peça do topo
+    j->pilha[j->topo] = j->fila[j->frente];   // Topo recebe peça da frente
+    j->fila[j->frente] = temp;        // Frente recebe peça do topo
+    FALAR("  Trocou topo da pilha com frente da fila!\n");
+    return RESULTADO_OK;
+}
+
+int trocarTopoComFrente(Jogo *j) { return nucleoTrocar(j, 1); }
+
+/* ============================================================= */
+/*  Função: trocarBloco()                                        */
+/*  Troca as k primeiras peças da fila com as k do topo da      */
+/*  pilha: a 1ª da fila com o topo, a 2ª com a de baixo dele... */
+/*  (k = 1 é a opção 4). Troca no lugar, peça por peça, andando */
+/*  na fila pelo índice circular a partir da frente: nenhuma    */
+/*  cópia temporária, e a fila e a pilha continuam com as mesmas*/
+/*  quantidades (a fila continua cheia). O núcleo é mudo        */
+/*  (falar = 0, como os outros); trocarBloco() é quem fala.     */
+/* ============================================================= */
+static inline void trocarPecas(Peca *a, Peca *b) { Peca t = *a; *a = *b; *b = t; }
+
+static inline void permutarBloco(Jogo *j, int k) {
+    if (k == TAM_PILHA && j->frente + TAM_PILHA <= ARMAZ_FILA) {
+        // Troca total com a reserva cheia (o caso da opção 6) sem dar a
+        // volta no array da fila: TAM_PILHA trocas fixas, que o
+        // compilador desenrola (sem laço, sem máscara)
+        for (int i = 0; i < TAM_PILHA; i++) trocarPecas(&j->fila[j->frente + i], &j->pilha[TAM_PILHA - 1 - i]);
+        return;
+    }
+    int f = j->frente;
+    for (int i = 0; i < k; i++) {
+        trocarPecas(&j->fila[f], &j->pilha[j->topo - i]);
+        f = (f + 1) & MASCARA_FILA;               // Próxima da fila (dá a volta no array)
+    }
+}
+
+static inline int nucleoTrocarBloco(Jogo *j, int falar, int k) {
+    if (k > j->qtdPilha) k = j->qtdPilha;         // Não dá para trocar mais do que tem
+    if (k > j->qtdFila) k = j->qtdFila;
+    if (k <= 0) {
+        FALAR("  Não é possível trocar: uma das estruturas está vazia!\n");
+        return RESULTADO_TROCA_IMPOSSIVEL;
+    }
+    permutarBloco(j, k);
+    FALAR("  Trocou %d peça(s) da frente da fila com o topo da pilha!\n", k);
+    return RESULTADO_OK;
+}
+
+int trocarBloco(Jogo *j, int k) { return nucleoTrocarBloco(j, 1, k); }
+
+/* ============================================================= */
+/*  Opção 6 – Inverter fila com pilha (SWAP TOTAL)              */
+/*  Toda a reserva troca de lugar com o começo da fila: é o     */
+/*  trocarBloco() com k = qtdPilha                               */
+/* ============================================================= */
+static inline int nucleoInverter(Jogo *j, int falar) {
+    int k = j->qtdPilha < j->qtdFila ? j->qtdPilha : j->qtdFila;
+    if (k == 0) {
+        FALAR("  Não é possível inverter: uma das estruturas está vazia!\n");
+        return RESULTADO_TROCA_IMPOSSIVEL;
+    }
+    permutarBloco(j, k);
+    FALAR("  Inverteu fila com pilha! (SWAP TOTAL)\n");
+    return RESULTADO_OK;
+}
+
+int inverterFilaComPilha(Jogo *j) { return nucleoInverter(j, 1); }
+
+#ifdef TEM_COMPACTO
+/* ------------------- Conversão e hash ------------------------ */
+// Tira o "retrato compacto" de um jogo (só os tipos, sem os ids)
+EstadoCompacto compactar(const Jogo *j) {
+    EstadoCompacto e = 0;
+    for (int c = 0; c < j->qtdFila; c++)
+        e |= (uint64_t)tipoDaLetra(j->fila[(j->frente + c) & MASCARA_FILA].nome) << (BITS_TIPO * c);
+    for (int c = 0; c < j->qtdPilha; c++)
+        e |= (uint64_t)tipoDaLetra(j->pilha[c].nome) << (DESLOC_PILHA_C + BITS_TIPO * c);
+    return e | ((uint64_t)j->qtdFila << DESLOC_QTD_FILA_C) | ((uint64_t)j->qtdPilha << DESLOC_QTD_PILHA_C);
+}
+#endif
+
+/* ============================================================= */
+/*  Funções de exibição                                          */
+/*  formatar*() escrevem num buffer; exibir*() imprimem direto  */
+/* ============================================================= */
+int formatarFila(const Jogo *j, char *dest, size_t tam) {
+    int n = snprintf(dest, tam, "Fila     : ");
+    if (j->qtdFila == 0) return n + snprintf(dest + n, tam - n, "<vazia>");
+    int i = j->frente;
+    for (int c = 0; c < j->qtdFila && (size_t)n < tam; c++) {
+        n += snprintf(dest + n, tam - n, "[%c %llu] ", j->fila[i].nome,
+                      (unsigned long long)idPeca(j, j->fila[i]));
+        i = (i + 1) & MASCARA_FILA;
+    }
+    return n;
+}
+
+int formatarPilha(const Jogo *j, char *dest, size_t tam) {
+    int n = snprintf(dest, tam, "Reserva  : ");
+    if (j->qtdPilha == 0) return n + snprintf(dest + n, tam - n, "<vazia>");
+    for (int i = j->topo; i >= 0 && (size_t)n < tam; i--)
+        n += snprintf(dest + n, tam - n, "[%c %llu] ", j->pilha[i].nome,
+                      (unsigned long long)idPeca(j, j->pilha[i]));
+    if ((size_t)n < tam) n += snprintf(dest + n, tam - n, " ← topo");
+    return n;
+}
+
+void exibirFila(const Jogo *j) {
+    char linha[COLUNAS_TELA];
+    formatarFila(j, linha, sizeof linha);
+    printf("%s\n", linha);
+}
+
+void exibirPilha(const Jogo *j) {
+    char linha[COLUNAS_TELA];
+    formatarPilha(j, linha, sizeof linha);
+    printf("%s\n", linha);
+}
+
+/* ============================================================= */
+/*  Função: iniciarJogo()                                        */
+/*  Zera um jogo, dá a ele uma cópia do gerador e enche a fila. */
+/*  Não imprime nada: serve para qualquer quantidade de sessões.*/
+/* ============================================================= */
+void iniciarJogo(Jogo *j, const GeradorPecas *gerador) {
+    memset(j, 0, sizeof *j);
+    j->topo = -1;                                 // Pilha vazia
+    j->historico.orcamento = ORCAMENTO_DESFAZER_PADRAO;
+    j->gerador = *gerador;
+    while (j->qtdFila < TAM_FILA) enqueue(j);     // Preenche a fila
+}
+
+/* ============================================================= */
+/*  Função: liberarJogo()                                        */
+/*  Devolve a memória do histórico de um jogo                   */
+/* ============================================================= */
+void liberarJogo(Jogo *j) {
+    desligarAlimentador(j);
+    desligarTabuleiro(j);
+    free(j->historico.dados);
+    j->historico.dados = NULL;
+    soltarRamo(j->ramo);
+    j->ramo = j->ramoAtual = NULL;
+}
+
+/* ============================================================= */
+/*  Função: juntarRamo()                                         */
+/*  O ramo "venceu": "destino" passa a ser ele (estado, peças e */
+/*  histórico), sem copiar nada além do próprio Jogo. O que era */
+/*  só do destino é liberado; o ramo fica vazio (liberarJogo    */
+/*  nele não faz nada).                                          */
+/* ============================================================= */
+void juntarRamo(Jogo *destino, Jogo *ramo) {
+    AnalisePecas *analise = destino->analise;     // A auditoria é de quem chamou: continua no destino
+    liberarJogo(destino);
+    *destino = *ramo;
+    destino->analise = analise;
+    ramo->alimentador = NULL;
+    ramo->tabuleiro = NULL;
+    ramo->historico.dados = NULL;
+    ramo->ramo = ramo->ramoAtual = NULL;
+}
+
+/* ============================================================= */
+/*  Função: conferirBiblioteca()                                 */
+/*  Quem usa a biblioteca passa a configuração com que foi      */
+/*  compilado (use CONFERIR_BIBLIOTECA()). Devolve 1 se bate    */
+/*  com a da biblioteca; se não, explica no stderr e devolve 0. */
+/* ============================================================= */
+int conferirBiblioteca(int versao, int tamFila, int tamPilha, size_t tamJogo) {
+    if (versao == VERSAO_TETRISSTACK && tamFila == TAM_FILA && tamPilha == TAM_PILHA && tamJogo == sizeof(Jogo))
+        return 1;
+    fprintf(stderr, "libtetrisstack: programa compilado com versão %d, TAM_FILA=%d, TAM_PILHA=%d (Jogo de %zu bytes);"
+                    " a biblioteca tem versão %d, TAM_FILA=%d, TAM_PILHA=%d (Jogo de %zu bytes)\n",
+            versao, tamFila, tamPilha, tamJogo, VERSAO_TETRISSTACK, TAM_FILA, TAM_PILHA, sizeof(Jogo));
+    return 0;
+}
+
+/* ============================================================= */
+/*  MÉTRICAS (compile com -DTETRIS_METRICAS para ligar)         */
+/* ============================================================= */
+// Em volta de cada ação do executarAcao() ficam:
+//   - quantas vezes cada ação foi chamada e quantas foram recusadas
+//     (por motivo: "Fila vazia!", "Reserva cheia!"...)
+//   - um histograma de latência por ação, no estilo HDR: até 64 ticks
+//     um balde por valor; depois disso, 32 baldes por potência de 2
+//     (erro máximo ~3%), qualquer que seja o tamanho do valor
+//   - "medidores" lidos na hora de exportar: ações no desfazer, bytes
+//     do histórico, peças na reserva e na fila do jogo registrado
+//
+// O relógio é o contador de ciclos (rdtsc) no x86, e só 1 ação a cada
+// AMOSTRAGEM_METRICAS é cronometrada (as contagens valem para todas):
+// ler o relógio duas vezes custa mais que uma jogada, então medir tudo
+// dobraria o tempo de cada ação. Com -DAMOSTRAGEM_METRICAS=1 mede todas.
+// A conversão para nanossegundos é feita só na exportação.
+// Sem -DTETRIS_METRICAS nada disso é compilado: custo zero.
+//
+// As métricas saem em JSON ou no formato texto do Prometheus, quando o
+// processo recebe SIGUSR1 e quando termina (--metrics json|prom,
+// --metrics-file caminho; sem arquivo vão para stderr).
+#ifdef TETRIS_METRICAS
+#include <signal.h>     // SIGUSR1: pedir as métricas com o programa rodando
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>  // __rdtsc
+#endif
+
+#ifndef AMOSTRAGEM_METRICAS
+#define AMOSTRAGEM_METRICAS 16        // Cronometra 1 ação a cada 16
+#endif
+#define BALDES_LINEARES 64
+#define SUB_BALDES 32
+#define QTD_BALDES (BALDES_LINEARES + (64 - 6) * SUB_BALDES)
+
+// Os baldes do histograma no Prometheus (em segundos): sempre os mesmos,
+// em toda exportação e em toda máquina, como o formato pede (os baldes
+// internos são em ticks e o tamanho do tick muda de máquina para máquina).
+static const double limitesPrometheus[] = {
+    25e-9, 50e-9, 100e-9, 250e-9, 500e-9, 1e-6, 2.5e-6, 5e-6, 10e-6, 25e-6, 50e-6,
+    100e-6, 250e-6, 500e-6, 1e-3, 2.5e-3, 5e-3, 10e-3, 25e-3, 50e-3, 100e-3, 250e-3, 500e-3, 1.0
+};
+
+// Os contadores são por thread: o simulador e os workers do servidor
+// chamam executarAcao() ao mesmo tempo, e um "++" num contador comum
+// perderia somas (e um histograma rasgado não soma o total). Cada thread
+// ganha o seu bloco na primeira ação e só ela escreve nele; a exportação
+// soma todos os blocos. A escrita é um load + store atômicos "relaxed"
+// (só um escritor, então não precisa de lock add): no x86 é o mesmo mov
+// de antes, e quem exporta no meio da partida lê valores inteiros.
+typedef _Atomic unsigned long long ContadorMetrica;
+
+typedef struct ContadoresMetricas {
+    ContadorMetrica chamadas[8];                    // Índice = código da ação (1 a 7)
+    ContadorMetrica recusas[8][QTD_RESULTADOS];     // Por ação e por motivo
+    ContadorMetrica amostras[8];                    // Quantas chamadas foram cronometradas
+    ContadorMetrica somaTicks[8];
+    ContadorMetrica maxTicks[8];
+    ContadorMetrica baldes[8][QTD_BALDES];
+    int contagem;                                   // Ações até a próxima cronometrada (só a dona usa)
+    struct ContadoresMetricas *proximo;             // Lista de todos os blocos (só cresce)
+} ContadoresMetricas;
+
+// A soma de todas as threads, montada na hora de exportar
+typedef struct {
+    unsigned long long chamadas[8];
+    unsigned long long recusas[8][QTD_RESULTADOS];
+    unsigned long long amostras[8];
+    unsigned long long somaTicks[8];
+    unsigned long long maxTicks[8];
+    unsigned long long baldes[8][QTD_BALDES];
+} TotaisMetricas;
+
+typedef struct {
+    unsigned long long ticksInicio;                 // Para converter ticks em ns na exportação
+    struct timespec relogioInicio;
+    const Jogo *jogo;                               // De onde vêm os medidores
+    int formatoJson;                                // 1 = JSON, 0 = Prometheus
+    const char *arquivo;                            // NULL = stderr
+} Metricas;
+
+Metricas metricas;
+volatile sig_atomic_t pedidoMetricas = 0;           // Ligado pelo SIGUSR1
+
+static _Thread_local ContadoresMetricas *contadoresThread;   // O bloco desta thread (NULL = ainda não tem)
+static ContadoresMetricas *todosContadores;
+static pthread_mutex_t travaContadores = PTHREAD_MUTEX_INITIALIZER;
+
+static inline unsigned long long lerTicksMetricas(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    return __rdtsc();
+#else
+    struct timespec t;
+    timespec_get(&t, TIME_UTC);
+    return (unsigned long long)t.tv_sec * 1000000000ULL + (unsigned long long)t.tv_nsec;
+#endif
+}
+
+static inline int indiceBalde(unsigned long long v) {
+    if (v < BALDES_LINEARES) return (int)v;
+    int e = 63 - __builtin_clzll(v);                // Posição do bit mais alto (>= 6)
+    return BALDES_LINEARES + (e - 6) * SUB_BALDES + (int)((v >> (e - 5)) & (SUB_BALDES - 1));
+}
+
+// Maior valor que cai no balde i
+static unsigned long long limiteBalde(int i) {
+    if (i < BALDES_LINEARES) return (unsigned long long)i;
+    int e = 6 + (i - BALDES_LINEARES) / SUB_BALDES, sub = (i - BALDES_LINEARES) % SUB_BALDES;
+    return ((unsigned long long)(SUB_BALDES + sub + 1) << (e - 5)) - 1;
+}
+
+static inline unsigned long long lerContador(const ContadorMetrica *c) {
+    return atomic_load_explicit(c, memory_order_relaxed);
+}
+
+// Só a thread dona escreve no bloco: ler, somar e gravar não perde nada
+static inline void somarContador(ContadorMetrica *c, unsigned long long v) {
+    atomic_store_explicit(c, lerContador(c) + v, memory_order_relaxed);
+}
+
+// O bloco da thread que chamou; cria (e coloca na lista) na primeira vez.
+// NULL se faltar memória: a ação roda sem ser contada.
+static ContadoresMetricas *contadoresDaThread(void) {
+    ContadoresMetricas *c = contadoresThread;
+    if (c != NULL) return c;
+    c = calloc(1, sizeof *c);
+    if (c == NULL) return NULL;
+    c->contagem = AMOSTRAGEM_METRICAS;
+    pthread_mutex_lock(&travaContadores);
+    c->proximo = todosContadores;
+    todosContadores = c;
+    pthread_mutex_unlock(&travaContadores);
+    return contadoresThread = c;
+}
+
+static inline void contarMetrica(ContadoresMetricas *c, int op, int resultado) {
+    somarContador(&c->chamadas[op], 1);
+    somarContador(&c->recusas[op][resultado], 1);   // recusas[op][RESULTADO_OK] = aceitas
+}
+
+static inline void registrarLatencia(ContadoresMetricas *c, int op, unsigned long long ticks) {
+    somarContador(&c->amostras[op], 1);
+    somarContador(&c->somaTicks[op], ticks);
+    if (ticks > lerContador(&c->maxTicks[op])) atomic_store_explicit(&c->maxTicks[op], ticks, memory_order_relaxed);
+    somarContador(&c->baldes[op][indiceBalde(ticks)], 1);
+}
+
+// Soma os blocos de todas as threads (as que já terminaram também contam)
+static void somarMetricas(TotaisMetricas *t) {
+    memset(t, 0, sizeof *t);
+    pthread_mutex_lock(&travaContadores);
+    for (ContadoresMetricas *c = todosContadores; c != NULL; c = c->proximo)
+        for (int op = 0; op < 8; op++) {
+            t->chamadas[op] += lerContador(&c->chamadas[op]);
+            for (int r = 0; r < QTD_RESULTADOS; r++) t->recusas[op][r] += lerContador(&c->recusas[op][r]);
+            t->amostras[op] += lerContador(&c->amostras[op]);
+            t->somaTicks[op] += lerContador(&c->somaTicks[op]);
+            unsigned long long max = lerContador(&c->maxTicks[op]);
+            if (max > t->maxTicks[op]) t->maxTicks[op] = max;
+            for (int i = 0; i < QTD_BALDES; i++) t->baldes[op][i] += lerContador(&c->baldes[op][i]);
+        }
+    pthread_mutex_unlock(&travaContadores);
+}
+
+static void tratarSinalMetricas(int sinal) { (void)sinal; pedidoMetricas = 1; }
+
+// Chamada antes das threads do jogo começarem: zera o que já foi contado
+void iniciarMetricas(const Jogo *j, int formatoJson, const char *arquivo) {
+    memset(&metricas, 0, sizeof metricas);
+    metricas.jogo = j;
+    metricas.formatoJson = formatoJson;
+    metricas.arquivo = arquivo;
+    pthread_mutex_lock(&travaContadores);
+    for (ContadoresMetricas *c = todosContadores; c != NULL; c = c->proximo) {
+        ContadoresMetricas *proximo = c->proximo;
+        memset(c, 0, sizeof *c);
+        c->contagem = AMOSTRAGEM_METRICAS;
+        c->proximo = proximo;
+    }
+    pthread_mutex_unlock(&travaContadores);
+    metricas.ticksInicio = lerTicksMetricas();
+    timespec_get(&metricas.relogioInicio, TIME_UTC);
+    signal(SIGUSR1, tratarSinalMetricas);
+}
+
+// Percentil q (0 a 1) do histograma da ação op, em ticks
+static unsigned long long percentilTicks(const TotaisMetricas *t, int op, double q) {
+    unsigned long long alvo = (unsigned long long)(q * t->amostras[op]), visto = 0;
+    for (int i = 0; i < QTD_BALDES; i++) {
+        visto += t->baldes[op][i];
+        if (visto > alvo) return limiteBalde(i);
+    }
+    return t->maxTicks[op];
+}
+
+/* ============================================================= */
+/*  Função: exportarMetricas()                                   */
+/*  Escreve tudo em JSON ou no formato do Prometheus            */
+/* ============================================================= */
+void exportarMetricas(void) {
+    static const char *nomesAcao[8] = { "", "jogar", "reservar", "usar_reservada", "trocar",
+                                        "desfazer", "inverter", "refazer" };
+    FILE *saida = metricas.arquivo != NULL ? fopen(metricas.arquivo, "w") : stderr;
+    if (saida == NULL) { fprintf(stderr, "Não foi possível criar '%s'\n", metricas.arquivo); return; }
+    TotaisMetricas *t = malloc(sizeof *t);          // ~120 KB: grande demais para a pilha de um worker
+    if (t == NULL) { if (saida != stderr) fclose(saida); return; }
+    somarMetricas(t);
+
+    struct timespec agora;
+    timespec_get(&agora, TIME_UTC);
+    double ns = (agora.tv_sec - metricas.relogioInicio.tv_sec) * 1e9 + (agora.tv_nsec - metricas.relogioInicio.tv_nsec);
+    unsigned long long ticks = lerTicksMetricas() - metricas.ticksInicio;
+    double nsPorTick = ticks > 0 ? ns / (double)ticks : 1.0;
+
+    const Jogo *j = metricas.jogo;
+    int desfazer = j ? j->historico.qtdDesfazer : 0;
+    unsigned long long bytesHist = j ? (unsigned long long)(j->historico.fim - j->historico.inicio) : 0;
+    int qtdPilha = j ? j->qtdPilha : 0, qtdFila = j ? j->qtdFila : 0;
+
+    if (metricas.formatoJson) {
+        fprintf(saida, "{\"acoes\":{");
+        for (int op = 1, primeiro = 1; op <= 7; op++) {
+            unsigned long long n = t->amostras[op];
+            fprintf(saida, "%s\"%s\":{\"chamadas\":%llu,\"recusas\":{", primeiro ? "" : ",", nomesAcao[op],
+                    t->chamadas[op]);
+            primeiro = 0;
+            for (int r = 1, pr = 1; r < QTD_RESULTADOS; r++) {
+                if (t->recusas[op][r] == 0) continue;
+                fprintf(saida, "%s\"%s\":%llu", pr ? "" : ",", nomesResultado[r], t->recusas[op][r]);
+                pr = 0;
+            }
+            fprintf(saida, "},\"latencia_ns\":{\"amostras\":%llu,\"media\":%.1f,\"p50\":%.1f,\"p99\":%.1f,\"p999\":%.1f,\"max\":%.1f}}",
+                    n, n ? t->somaTicks[op] * nsPorTick / n : 0.0,
+                    n ? percentilTicks(t, op, 0.50) * nsPorTick : 0.0,
+                    n ? percentilTicks(t, op, 0.99) * nsPorTick : 0.0,
+                    n ? percentilTicks(t, op, 0.999) * nsPorTick : 0.0,
+                    t->maxTicks[op] * nsPorTick);
+        }
+        fprintf(saida, "},\"amostragem\":%d,\"medidores\":{\"desfazer_acoes\":%d,\"desfazer_bytes\":%llu,"
+                       "\"reserva_pecas\":%d,\"fila_pecas\":%d}}\n", AMOSTRAGEM_METRICAS, desfazer, bytesHist, qtdPilha, qtdFila);
+    } else {
+        fprintf(saida, "# TYPE tetris_acoes_total counter\n");
+        for (int op = 1; op <= 7; op++)
+            fprintf(saida, "tetris_acoes_total{acao=\"%s\"} %llu\n", nomesAcao[op], t->chamadas[op]);
+        fprintf(saida, "# TYPE tetris_recusas_total counter\n");
+        for (int op = 1; op <= 7; op++)
+            for (int r = 1; r < QTD_RESULTADOS; r++)
+                if (t->recusas[op][r] > 0)
+                    fprintf(saida, "tetris_recusas_total{acao=\"%s\",motivo=\"%s\"} %llu\n",
+                            nomesAcao[op], nomesResultado[r], t->recusas[op][r]);
+        // O histograma conta só as ações cronometradas (1 a cada AMOSTRAGEM_METRICAS).
+        // Cada balde interno entra no primeiro "le" que cobre o maior valor dele;
+        // todos os "le" saem, mesmo vazios, com a contagem acumulada.
+        fprintf(saida, "# TYPE tetris_latencia_segundos histogram\n");
+        for (int op = 1; op <= 7; op++) {
+            unsigned long long acumulado = 0;
+            int i = 0;
+            for (size_t b = 0; b < sizeof limitesPrometheus / sizeof limitesPrometheus[0]; b++) {
+                for (; i < QTD_BALDES && limiteBalde(i) * nsPorTick / 1e9 <= limitesPrometheus[b]; i++)
+                    acumulado += t->baldes[op][i];
+                fprintf(saida, "tetris_latencia_segundos_bucket{acao=\"%s\",le=\"%g\"} %llu\n",
+                        nomesAcao[op], limitesPrometheus[b], acumulado);
+            }
+            for (; i < QTD_BALDES; i++) acumulado += t->baldes[op][i];
+            fprintf(saida, "tetris_latencia_segundos_bucket{acao=\"%s\",le=\"+Inf\"} %llu\n", nomesAcao[op], acumulado);
+            fprintf(saida, "tetris_latencia_segundos_sum{acao=\"%s\"} %.9g\n", nomesAcao[op],
+                    t->somaTicks[op] * nsPorTick / 1e9);
+            fprintf(saida, "tetris_latencia_segundos_count{acao=\"%s\"} %llu\n", nomesAcao[op], t->amostras[op]);
+        }
+        fprintf(saida, "# TYPE tetris_desfazer_acoes gauge\ntetris_desfazer_acoes %d\n", desfazer);
+        fprintf(saida, "# TYPE tetris_desfazer_bytes gauge\ntetris_desfazer_bytes %llu\n", bytesHist);
+        fprintf(saida, "# TYPE tetris_reserva_pecas gauge\ntetris_reserva_pecas %d\n", qtdPilha);
+        fprintf(saida, "# TYPE tetris_fila_pecas gauge\ntetris_fila_pecas %d\n", qtdFila);
+    }
+    free(t);
+    if (saida != stderr) fclose(saida);
+    else fflush(saida);
+}
+#endif
+
+// O que a linha de comando pediu (--metrics, --metrics-file)
+int formatoMetricas = 0;              // 0 = nada, 1 = JSON, 2 = Prometheus
+const char *arquivoMetricas = NULL;   // NULL = stderr
+
+void ligarMetricas(const Jogo *j) {
+#ifdef TETRIS_METRICAS
+    if (formatoMetricas) iniciarMetricas(j, formatoMetricas == 1, arquivoMetricas);
+#else
+    (void)j;
+#endif
+}
+
+void terminarMetricas(void) {
+#ifdef TETRIS_METRICAS
+    if (formatoMetricas) exportarMetricas();
+#endif
+}
+
+/* ============================================================= */
+/*  Função: executarAcao()                                       */
+/*  Chama a função certa para o código da ação (1 a 7)          */
+/*  Usada tanto pelo menu interativo quanto pelo modo batch     */
+/*  Toda ação (menos desfazer/refazer) é registrada no histórico */
+/*  Devolve o RESULTADO_* da ação (ACAO_INVALIDA se "op" não    */
+/*  for de 1 a 7: nada acontece e nada é contado)               */
+/* ============================================================= */
+// "op" já conferido (1 a 7) por quem chama: vira índice das métricas
+static inline int despacharAcao(Jogo *j, int op, int falar, Peca jogadas[2]) {
+    if (op == 5) return nucleoDesfazer(j, falar);
+    if (op == 7) return nucleoRefazer(j, falar);
+
+    Estado antes;
+    int r = RESULTADO_OK;
+    salvarEstado(j, &antes);            // Foto de antes da ação
+    switch (op) {
+        case 1: r = nucleoJogar(j, falar, jogadas); break;
+        case 2: r = nucleoReservar(j, falar);       break;
+        case 3: r = nucleoUsar(j, falar, jogadas);  break;
+        case 4: r = nucleoTrocar(j, falar);         break;
+        case 6: r = nucleoInverter(j, falar);       break;
+    }
+    if (r == RESULTADO_OK) registrarDelta(j, &antes);   // Guarda só o que a ação mudou
+    return r;
+}
+
+int executarAcao(Jogo *j, int op) {
+    if (op < 1 || op > 7) return RESULTADO_ACAO_INVALIDA;
+    Peca jogadas[2];
+#ifdef TETRIS_METRICAS
+    ContadoresMetricas *c = contadoresDaThread();
+    if (c == NULL) return despacharAcao(j, op, 1, jogadas);
+    int r;
+    if (--c->contagem == 0) {                       // Esta é cronometrada
+        c->contagem = AMOSTRAGEM_METRICAS;
+        unsigned long long t0 = lerTicksMetricas();
+        r = despacharAcao(j, op, 1, jogadas);
+        registrarLatencia(c, op, lerTicksMetricas() - t0);
+    } else {
+        r = despacharAcao(j, op, 1, jogadas);
+    }
+    contarMetrica(c, op, r);
+    return r;
+#else
+    return despacharAcao(j, op, 1, jogadas);
+#endif
+}
+
+/* ============================================================= */
+/*  Função: aplicarAcoes()                                       */
+/*  Aplica "n" ações seguidas (códigos 1 a 7, os números, não   */
+/*  os caracteres '1' a '7') numa chamada só, para quem         */
+/*  controla o jogo de fora e manda milhares de jogadas de uma  */
+/*  vez. Mesmas regras e mesmo histórico do executarAcao(), mas */
+/*  sem nenhuma mensagem (nem o teste do modoSilencioso).       */
+/*                                                               */
+/*  Se não forem NULL, os arrays paralelos recebem, para cada   */
+/*  ação i:                                                      */
+/*    resultados[i] → o RESULTADO_* dela (ACAO_INVALIDA se o     */
+/*                    código não for de 1 a 7: nada acontece)   */
+/*    jogadas[2*i], → as peças que ela mandou para o tabuleiro, */
+/*    jogadas[2*i+1]  na ordem: a da frente e PECA_NENHUMA      */
+/*                    (opção 1), a reservada e a da frente      */
+/*                    (opção 3) ou PECA_NENHUMA nas duas (as    */
+/*                    outras). O array tem 2*n vagas.           */
+/*  Devolve quantas ações deram certo.                          */
+/* ============================================================= */
+size_t aplicarAcoes(Jogo *j, const unsigned char *acoes, size_t n, unsigned char *resultados, Peca *jogadas) {
+    size_t certas = 0;
+#ifdef TETRIS_METRICAS
+    ContadoresMetricas *c = contadoresDaThread();
+#endif
+    for (size_t i = 0; i < n; i++) {
+        int op = acoes[i];
+        Peca jogada[2] = { PECA_NENHUMA, PECA_NENHUMA };
+        int r = RESULTADO_ACAO_INVALIDA;
+        if (op >= 1 && op <= 7) {
+            r = despacharAcao(j, op, 0, jogada);
+#ifdef TETRIS_METRICAS
+            if (c != NULL) contarMetrica(c, op, r);   // Conta, mas não cronometra: o lote é o ponto
+#endif
+        }
+        certas += r == RESULTADO_OK;
+        if (resultados != NULL) resultados[i] = (unsigned char)r;
+        if (jogadas != NULL) { jogadas[2 * i] = jogada[0]; jogadas[2 * i + 1] = jogada[1]; }
+    }
+    return certas;
+}
+
+/* ============================================================= */
+/*  Função: resumoEstado()                                       */
+/*  Calcula um "resumo" (hash FNV-1a) da fila, da pilha e dos   */
+/*  contadores. Duas execuções iguais dão o mesmo número.       */
+/* ============================================================= */
+unsigned long long resumoEstado(const Jogo *j) {
+    unsigned long long h = 1469598103934665603ULL;    // Valor inicial do FNV-1a 64 bits
+    #define MISTURA(v) (h = (h ^ (unsigned long long)(v)) * 1099511628211ULL)
+    int i = j->frente;
+    for (int c = 0; c < j->qtdFila; c++) {            // Fila na ordem lógica (da frente ao fim)
+        MISTURA(j->fila[i].nome); MISTURA(j->fila[i].id);
+        i = (i + 1) & MASCARA_FILA;
+    }
+    MISTURA(j->qtdFila);
+    for (int c = 0; c < j->qtdPilha; c++) {           // Pilha do fundo até o topo
+        MISTURA(j->pilha[c].nome); MISTURA(j->pilha[c].id);
+    }
+    MISTURA(j->qtdPilha);
+    MISTURA(proximoIdCompleto(j));
+    #undef MISTURA
+    return h;
+}
+
+/* ============================================================= */
+/*  LEITURA DE AÇÕES (entrada padrão, no lugar do scanf)         */
+/* ============================================================= */
+// O scanf("%d") custa caro por chamada e, pior, com uma entrada que
+// não é número ("abc") ele não consome nada: o laço do menu lia o mesmo
+// "abc" para sempre. O leitor lê de 64 KB em 64 KB com read() e separa
+// as "palavras" (o que estiver entre espaços e quebras de linha):
+//   - palavra que é um número inteiro ("3", "+3", "-1") → devolvida
+//   - qualquer outra ("abc", "12x", "99999999999") → consumida INTEIRA,
+//     contada em "malformados", e lerNumero() devolve -1 (o menu avisa
+//     e pede de novo; nada fica parado no buffer)
+//   - fim da entrada → lerNumero() devolve 0 (quem chama trata como sair)
+// Num terminal, o printf que está esperando (o prompt sem '\n') sai
+// antes do read(), como o scanf fazia.
+
+static inline int ehEspaco(int c) { return c == ' ' || (c >= '\t' && c <= '\r'); }
+
+/* ============================================================= */
+/*  Função: iniciarLeitor()                                      */
+/* ============================================================= */
+void iniciarLeitor(LeitorAcoes *l, int fd) {
+    l->fd = fd;
+    l->pos = l->tam = 0;
+    l->fim = 0;
+    l->terminal = isatty(fd);
+    l->malformados = l->foraDoMenu = 0;
+}
+
+// Lê o próximo pedaço da entrada. 0 = acabou (fim ou erro de leitura)
+static int encherLeitor(LeitorAcoes *l) {
+    if (l->fim) return 0;
+    if (l->terminal) fflush(stdout);
+    ssize_t n;
+    do n = read(l->fd, l->buf, sizeof l->buf); while (n < 0 && errno == EINTR);
+    l->pos = 0;
+    l->tam = n > 0 ? (size_t)n : 0;
+    if (n <= 0) l->fim = 1;
+    return n > 0;
+}
+
+static inline int pegarByte(LeitorAcoes *l) {
+    if (l->pos == l->tam && !encherLeitor(l)) return -1;
+    return l->buf[l->pos++];
+}
+
+/* ============================================================= */
+/*  Função: lerNumero()                                          */
+/*  Lê a próxima palavra da entrada. Devolve 1 (número, em      */
+/*  *valor), -1 (não era número: pulada) ou 0 (fim da entrada). */
+/* ============================================================= */
+int lerNumero(LeitorAcoes *l, int *valor) {
+    int c;
+    do c = pegarByte(l); while (c >= 0 && ehEspaco(c));
+    if (c < 0) return 0;                          // Acabou a entrada
+
+    int negativo = 0, digitos = 0, ruim = 0;
+    long long v = 0;
+    if (c == '+' || c == '-') { negativo = c == '-'; c = pegarByte(l); }
+    for (; c >= 0 && !ehEspaco(c); c = pegarByte(l)) {   // A palavra pode atravessar dois pedaços
+        if (c >= '0' && c <= '9' && digitos < 10) { v = v * 10 + (c - '0'); digitos++; }
+        else ruim = 1;
+    }
+    if (ruim || digitos == 0 || v > 2147483647LL) { l->malformados++; return -1; }
+    *valor = (int)(negativo ? -v : v);
+    return 1;
+}
+
+/* ============================================================= */
+/*  Função: lerAcoes()                                           */
+/*  Enche "codigos" com até "max" ações (1 a 7) da entrada, para */
+/*  mandar direto ao aplicarAcoes(). Números fora do menu são    */
+/*  pulados (contados em foraDoMenu). Liga *sair no 0 ou no fim. */
+/*  O caso comum (um dígito + quebra de linha) é lido direto do  */
+/*  buffer, dois bytes por ação.                                 */
+/* ============================================================= */
+size_t lerAcoes(LeitorAcoes *l, unsigned char *codigos, size_t max, int *sair) {
+    size_t m = 0;
+    *sair = 0;
+    while (m < max) {
+        const unsigned char *b = l->buf;
+        size_t p = l->pos, tam = l->tam;
+        while (m < max && p + 1 < tam) {          // Caminho rápido, sem sair do buffer
+            unsigned c = b[p];
+            if (c - '1' < 7u && ehEspaco(b[p + 1])) { codigos[m++] = (unsigned char)(c - '0'); p += 2; }
+            else if (ehEspaco((int)c)) p++;
+            else break;
+        }
+        l->pos = p;
+        if (m == max) break;
+
+        int op;                                   // Palavra que não cabe no caminho rápido
+        int lido = lerNumero(l, &op);
+        if (lido < 0) continue;                   // Não era número (já contado)
+        if (lido == 0 || op == 0) { *sair = 1; break; }
+        if (op >= 1 && op <= 7) codigos[m++] = (unsigned char)op;
+        else l->foraDoMenu++;
+    }
+    return m;
+}
+
+// A parte quente e o gerador vão para o keyframe no mesmo layout da
+// memória (restaurar é um memcpy de volta), mas campo a campo sobre
+// bytes zerados: os buracos de alinhamento (depois de saco[], no fim do
+// gerador e, em algumas configurações, em volta de proximoId) saem
+// sempre 0, e não o lixo que estiver no Jogo. Mesmo jogo → mesmos bytes
+static void escreverParteQuente(unsigned char *d, const Jogo *j) {
+    memset(d, 0, BYTES_HOT);
+    memcpy(d, j, offsetof(Jogo, topo) + sizeof j->topo);             // Fila, pilha e índices (sem buracos)
+    memcpy(d + offsetof(Jogo, proximoId), &j->proximoId, sizeof j->proximoId);
+}
+
+static void escreverGerador(unsigned char *d, const GeradorPecas *g) {
+    memset(d, 0, sizeof *g);
+    memcpy(d + offsetof(GeradorPecas, s), g->s, sizeof g->s);
+    memcpy(d + offsetof(GeradorPecas, modo), &g->modo, sizeof g->modo);
+    memcpy(d + offsetof(GeradorPecas, saco), g->saco, sizeof g->saco);
+    memcpy(d + offsetof(GeradorPecas, posSaco), &g->posSaco, sizeof g->posSaco);
+    memcpy(d + offsetof(GeradorPecas, lote), g->lote, sizeof g->lote);
+    memcpy(d + offsetof(GeradorPecas, posLote), &g->posLote, sizeof g->posLote);
+}
+
+/* ============================================================= */
+/*  Função: serializarKeyframe()                                 */
+/*  Escreve o jogo inteiro em "dest" e devolve quantos bytes    */
+/* ============================================================= */
+size_t serializarKeyframe(const Jogo *j, uint64_t passo, unsigned char *dest) {
+    const LogDesfazer *h = &j->historico;
+    uint32_t usados = (uint32_t)(h->fim - h->inicio);
+    uint32_t cursor = (uint32_t)(h->cursor - h->inicio);
+    uint32_t tam = (uint32_t)(BYTES_FIXOS_KEYFRAME + usados);
+    uint64_t orcamento = h->orcamento, capacidade = h->capacidade;
+    int32_t qtdDesfazer = h->qtdDesfazer, qtdRefazer = h->qtdRefazer;
+    unsigned char *d = dest;
+    memcpy(d, &tam, 4);                         d += 4;
+    memcpy(d, &passo, 8);                       d += 8;
+    escreverParteQuente(d, j);                  d += BYTES_HOT;      // Fila, pilha, índices, proximoId
+    escreverGerador(d, &j->gerador);            d += sizeof j->gerador;
+    memcpy(d, &j->epocaId, 4);                  d += 4;
+    memcpy(d, &orcamento, 8);                   d += 8;
+    memcpy(d, &capacidade, 8);                  d += 8;
+    memcpy(d, &usados, 4);                      d += 4;
+    memcpy(d, &cursor, 4);                      d += 4;
+    memcpy(d, &qtdDesfazer, 4);                 d += 4;
+    memcpy(d, &qtdRefazer, 4);                  d += 4;
+    if (usados > 0) lerBytesLog(h, h->inicio, d, usados);            // O histórico, já "desenrolado"
+    return tam;
+}
+
+// Confere os campos do keyframe que, errados, fariam o jogo ler fora
+// dos arrays (a soma de verificação pega arquivo estragado; isto pega
+// keyframe montado errado, e a gravação .tsr, que não tem soma, conta
+// só com isto). "tam" = bytes do keyframe (tamanho exato).
+static int keyframeValido(const unsigned char *orig, size_t tam) {
+    Jogo quente;                                  // Só a parte quente e o gerador são lidos
+    uint32_t tamKeyframe, usados, cursor;
+    uint64_t capacidade;
+    int32_t qtdDesfazer, qtdRefazer;
+    if (tam < BYTES_FIXOS_KEYFRAME) return 0;
+    const unsigned char *o = orig;
+    memcpy(&tamKeyframe, o, 4);                   o += 4 + 8;
+    memcpy(&quente, o, BYTES_HOT);                o += BYTES_HOT;
+    memcpy(&quente.gerador, o, sizeof quente.gerador);   o += sizeof quente.gerador + 4 + 8;
+    memcpy(&capacidade, o, 8);                    o += 8;
+    memcpy(&usados, o, 4);                        o += 4;
+    memcpy(&cursor, o, 4);                        o += 4;
+    memcpy(&qtdDesfazer, o, 4);                   o += 4;
+    memcpy(&qtdRefazer, o, 4);
+
+    if (tamKeyframe != tam || tam != BYTES_FIXOS_KEYFRAME + (size_t)usados) return 0;
+    if (capacidade == 0 ? usados != 0 : (capacidade & (capacidade - 1)) != 0 || usados > capacidade) return 0;
+    if (cursor > usados || qtdDesfazer < 0 || qtdRefazer < 0) return 0;
+    if (quente.frente >= ARMAZ_FILA || quente.tras >= ARMAZ_FILA || quente.qtdFila > TAM_FILA) return 0;
+    if (quente.qtdPilha > TAM_PILHA || quente.topo != quente.qtdPilha - 1) return 0;
+    const GeradorPecas *g = &quente.gerador;
+    if (g->modo != MODO_ALEATORIO && g->modo != MODO_SACO) return 0;
+    if (g->posLote < 0 || g->posLote > LOTE_PECAS || g->posSaco < 0 || g->posSaco > 7) return 0;
+    for (int i = 0; i < LOTE_PECAS; i++) if (g->lote[i] >= 7) return 0;
+    for (int i = 0; i < 7; i++) if (g->saco[i] >= 7) return 0;
+    return 1;
+}
+
+/* ============================================================= */
+/*  Função: restaurarKeyframe()                                  */
+/*  O contrário: monta o jogo a partir de um keyframe que está  */
+/*  nos "tam" bytes de "orig" (pode sobrar: as ações vêm logo   */
+/*  depois). Devolve o passo do keyframe, -1 se faltar memória  */
+/*  ou -2 se o keyframe não couber em "tam" ou estiver errado.  */
+/*  Nos dois erros o jogo continua como estava: tudo é          */
+/*  conferido e a arena é alocada antes de mexer nele.          */
+/*  Se a arena que o jogo já tem for do mesmo tamanho, ela é    */
+/*  reaproveitada (restaurar várias vezes não faz malloc)       */
+/* ============================================================= */
+long long restaurarKeyframe(Jogo *j, const unsigned char *orig, size_t tam) {
+    uint32_t tamKeyframe;
+    if (tam < 4) return -2;
+    memcpy(&tamKeyframe, orig, 4);
+    if (tamKeyframe > tam || !keyframeValido(orig, tamKeyframe)) return -2;
+
+    uint64_t passo, orcamento, capacidade;
+    uint32_t usados, cursor;
+    int32_t qtdDesfazer, qtdRefazer;
+    const unsigned char *o = orig + 4 + 8 + BYTES_HOT + sizeof j->gerador + 4;
+    memcpy(&orcamento, o, 8);                   o += 8;
+    memcpy(&capacidade, o, 8);                  o += 8;
+    memcpy(&usados, o, 4);                      o += 4;
+    memcpy(&cursor, o, 4);                      o += 4;
+    memcpy(&qtdDesfazer, o, 4);                 o += 4;
+    memcpy(&qtdRefazer, o, 4);                  o += 4;
+
+    LogDesfazer *h = &j->historico;
+    unsigned char *arena = NULL;
+    if (capacidade > 0) {
+        if (h->dados != NULL && h->capacidade == capacidade) { arena = h->dados; h->dados = NULL; }
+        else if ((arena = malloc(capacidade)) == NULL) return -1;
+    }
+    liberarJogo(j);
+    const unsigned char *q = orig + 4;
+    memcpy(&passo, q, 8);                       q += 8;
+    memcpy(j, q, BYTES_HOT);                    q += BYTES_HOT;
+    memcpy(&j->gerador, q, sizeof j->gerador);  q += sizeof j->gerador;
+    memcpy(&j->epocaId, q, 4);
+
+    memset(h, 0, sizeof *h);
+    h->orcamento = orcamento;
+    if (capacidade > 0) {                       // Mesma capacidade de antes → mesmos descartes no futuro
+        h->dados = arena;
+        h->capacidade = capacidade;
+        memcpy(h->dados, o, usados);
+    }
+    h->inicio = 0;
+    h->cursor = cursor;
+    h->fim = usados;
+    h->qtdDesfazer = qtdDesfazer;
+    h->qtdRefazer = qtdRefazer;
+    return (long long)passo;
+}
+
+/* ------------------- Thread de escrita ---------------------- */
+static void *rodarGravador(void *arg) {
+    Gravador *g = arg;
+    pthread_mutex_lock(&g->trava);
+    for (int k = 0; ; k = !k) {                 // Grava os buffers na ordem: 0, 1, 0, 1...
+        while (!g->pronto[k] && !g->encerrar) pthread_cond_wait(&g->sinal, &g->trava);
+        if (!g->pronto[k]) break;               // Encerrar e nada mais para gravar
+        pthread_mutex_unlock(&g->trava);
+        int ok = fwrite(g->buffers[k], 1, g->tamanhos[k], g->arquivo) == g->tamanhos[k];
+        pthread_mutex_lock(&g->trava);
+        if (!ok) g->erro = 1;
+        g->pronto[k] = 0;
+        pthread_cond_broadcast(&g->sinal);
+    }
+    pthread_mutex_unlock(&g->trava);
+    return NULL;
+}
+
+// Entrega o buffer atual para a thread e passa a encher o outro
+static void trocarBufferGravacao(Gravador *g) {
+    pthread_mutex_lock(&g->trava);
+    g->tamanhos[g->atual] = g->usado;
+    g->pronto[g->atual] = 1;
+    pthread_cond_broadcast(&g->sinal);
+    g->posicao += g->usado;
+    g->atual = !g->atual;
+    while (g->pronto[g->atual]) pthread_cond_wait(&g->sinal, &g->trava);   // Disco atrasado: espera
+    pthread_mutex_unlock(&g->trava);
+    g->usado = 0;
+}
+
+/* ============================================================= */
+/*  Função: abrirGravacao()                                      */
+/*  Cria o arquivo, grava o cabeçalho e liga a thread de escrita */
+/* ============================================================= */
+int abrirGravacao(Gravador *g, const char *caminho, const Jogo *j, uint64_t semente, int modo) {
+    memset(g, 0, sizeof *g);
+    g->arquivo = fopen(caminho, "wb");
+    if (g->arquivo == NULL) {
+        fprintf(stderr, "Não foi possível criar '%s'\n", caminho);
+        return 0;
+    }
+    CabecalhoGravacao c = { {'T', 'S', 'R', 'P'}, VERSAO_GRAVACAO, MARCA_ORDEM_BYTES,
+                            TAM_FILA, TAM_PILHA, (uint8_t)modo, 0, INTERVALO_KEYFRAME,
+                            semente, j->historico.orcamento };
+    fwrite(&c, sizeof c, 1, g->arquivo);
+    g->posicao = sizeof c;
+
+    // Um buffer cabe um bloco inteiro: o maior keyframe + as ações
+    size_t maxHistorico = j->historico.orcamento > 0 ? j->historico.orcamento : 1;
+    g->capacidadeBuffer = BYTES_FIXOS_KEYFRAME + maxHistorico + (3 * INTERVALO_KEYFRAME + 7) / 8;
+    g->buffers[0] = malloc(g->capacidadeBuffer);
+    g->buffers[1] = malloc(g->capacidadeBuffer);
+    if (g->buffers[0] == NULL || g->buffers[1] == NULL) {
+        fprintf(stderr, "Memória insuficiente para gravar\n");
+        free(g->buffers[0]); free(g->buffers[1]);
+        fclose(g->arquivo);
+        return 0;
+    }
+    pthread_mutex_init(&g->trava, NULL);
+    pthread_cond_init(&g->sinal, NULL);
+    if (pthread_create(&g->thread, NULL, rodarGravador, g) != 0) {   // Sem a thread ninguém gravaria os buffers
+        fprintf(stderr, "Não foi possível iniciar a thread de gravação\n");
+        pthread_mutex_destroy(&g->trava);
+        pthread_cond_destroy(&g->sinal);
+        free(g->buffers[0]); free(g->buffers[1]);
+        fclose(g->arquivo);
+        return 0;
+    }
+    return 1;
+}
+
+/* ============================================================= */
+/*  Função: gravarAcao()                                         */
+/*  Chamada ANTES de executar a ação: no começo de cada bloco o */
+/*  keyframe precisa do estado de antes dela                    */
+/*  Se faltar memória para o índice, a gravação para no último  */
+/*  bloco completo (o arquivo continua válido até ele)          */
+/* ============================================================= */
+void gravarAcao(Gravador *g, const Jogo *j, int op) {
+    if (g->parou) return;
+    uint64_t n = g->passos % INTERVALO_KEYFRAME;
+    if (n == 0) {                               // Começa um bloco novo
+        if (g->passos > 0) trocarBufferGravacao(g);
+        if (g->qtdIndice == g->capIndice) {
+            size_t capacidade = g->capIndice ? 2 * g->capIndice : 64;
+            uint64_t *indice = realloc(g->indice, capacidade * 2 * sizeof(uint64_t));
+            if (indice == NULL) {
+                fprintf(stderr, "Memória insuficiente: a gravação parou no passo %llu\n", (unsigned long long)g->passos);
+                g->parou = 1;
+                return;
+            }
+            g->indice = indice;
+            g->capIndice = capacidade;
+        }
+        g->indice[2 * g->qtdIndice] = g->passos;
+        g->indice[2 * g->qtdIndice + 1] = g->posicao;
+        g->qtdIndice++;
+        g->usado = serializarKeyframe(j, g->passos, g->buffers[g->atual]);
+        g->inicioAcoes = g->usado;
+        memset(g->buffers[g->atual] + g->usado, 0, g->capacidadeBuffer - g->usado);
+    }
+    // A ação n do bloco ocupa os bits 3n a 3n+2 (pode atravessar dois bytes)
+    unsigned char *acoes = g->buffers[g->atual] + g->inicioAcoes;
+    size_t bit = 3 * (size_t)n;
+    unsigned v = (unsigned)op << (bit & 7);
+    acoes[bit >> 3] |= (unsigned char)v;
+    if (v >> 8) acoes[(bit >> 3) + 1] |= (unsigned char)(v >> 8);
+    g->usado = g->inicioAcoes + (bit + 3 + 7) / 8;
+    g->passos++;
+}
+
+/* ============================================================= */
+/*  Função: fecharGravacao()                                     */
+/*  Manda o último bloco, grava índice e rodapé e fecha tudo    */
+/* ============================================================= */
+int fecharGravacao(Gravador *g) {
+    if (g->passos > 0 && !g->parou) trocarBufferGravacao(g);   // Se parou, o último bloco já foi entregue
+    pthread_mutex_lock(&g->trava);
+    g->encerrar = 1;
+    pthread_cond_broadcast(&g->sinal);
+    pthread_mutex_unlock(&g->trava);
+    pthread_join(g->thread, NULL);
+
+    RodapeGravacao r = { g->qtdIndice, g->posicao, g->passos, {'T', 'S', 'R', 'I'}, 0 };
+    if (g->qtdIndice > 0) fwrite(g->indice, 2 * sizeof(uint64_t), g->qtdIndice, g->arquivo);
+    fwrite(&r, sizeof r, 1, g->arquivo);
+    int ok = fclose(g->arquivo) == 0 && !g->erro && !g->parou;
+    if (!ok) fprintf(stderr, "Erro ao gravar a partida\n");
+
+    pthread_mutex_destroy(&g->trava);
+    pthread_cond_destroy(&g->sinal);
+    free(g->buffers[0]); free(g->buffers[1]); free(g->indice);
+    return ok;
+}
+
+/* ============================================================= */
+/*  SNAPSHOT DA SESSÃO (suspender e continuar depois)            */
+/* ============================================================= */
+const char *mensagensSnapshot[QTD_ERROS_SNAPSHOT] = {
+    "ok", "arquivo truncado", "formato desconhecido (ou de uma máquina de outra ordem de bytes)",
+    "versão desconhecida", "compilado com outra configuração (TAM_FILA, TAM_PILHA, tabuleiro...)",
+    "soma de verificação não bate (arquivo corrompido)", "memória insuficiente"
+};
+
+// Soma de verificação de 64 bits no estilo do xxHash64: 4 acumuladores
+// independentes comem 32 bytes por volta (a CPU faz as 4 multiplicações
+// em paralelo), então conferir o snapshot custa bem menos que copiá-lo
+#define PRIMO_V1 0x9E3779B185EBCA87ULL
+#define PRIMO_V2 0xC2B2AE3D27D4EB4FULL
+#define PRIMO_V3 0x165667B19E3779F9ULL
+
+static inline uint64_t rodadaVerificacao(uint64_t acumulador, uint64_t palavra) {
+    return rotl64(acumulador + palavra * PRIMO_V2, 31) * PRIMO_V1;
+}
+
+static uint64_t somaVerificacao(const unsigned char *dados, size_t n) {
+    uint64_t v[4] = { PRIMO_V1 + PRIMO_V2, PRIMO_V2, 0, 0 - PRIMO_V1 }, palavra;
+    size_t k = 0;
+    for (; k + 32 <= n; k += 32)
+        for (int i = 0; i < 4; i++) { memcpy(&palavra, dados + k + 8 * i, 8); v[i] = rodadaVerificacao(v[i], palavra); }
+    uint64_t h = rotl64(v[0], 1) + rotl64(v[1], 7) + rotl64(v[2], 12) + rotl64(v[3], 18) + n;
+    for (; k + 8 <= n; k += 8) {
+        memcpy(&palavra, dados + k, 8);
+        h = rotl64(h ^ rodadaVerificacao(0, palavra), 27) * PRIMO_V1 + PRIMO_V3;
+    }
+    for (; k < n; k++) h = rotl64(h ^ (dados[k] * PRIMO_V3), 11) * PRIMO_V1;
+    h ^= h >> 33; h *= PRIMO_V2;                  // Mistura final: todo bit de entrada mexe em todos
+    h ^= h >> 29; h *= PRIMO_V3;
+    return h ^ (h >> 32);
+}
+
+/* ============================================================= */
+/*  Função: tamanhoSnapshot()                                    */
+/*  Quantos bytes salvarSnapshot() vai escrever para este jogo  */
+/* ============================================================= */
+size_t tamanhoSnapshot(const Jogo *j) {
+    size_t n = sizeof(CabecalhoSnapshot) + BYTES_FIXOS_KEYFRAME;
+    if (j->ramoAtual == NULL) n += j->historico.fim - j->historico.inicio;
+    if (j->tabuleiro != NULL) n += sizeof(Tabuleiro);
+    return n;
+}
+
+/* ============================================================= */
+/*  Função: salvarSnapshot()                                     */
+/*  Escreve a sessão inteira em "dest": cabeçalho, keyframe     */
+/*  (fila, pilha, contadores, gerador, histórico) e o tabuleiro */
+/*  (se tiver). Devolve os bytes escritos, ou 0 se não couber   */
+/*  em "capacidade" (veja tamanhoSnapshot).                     */
+/*                                                               */
+/*  O histórico herdado de um ramo (bifurcarJogo) não vai: o    */
+/*  jogo restaurado desfaz só até a bifurcação. Se ele estava   */
+/*  desfeito para dentro do ramo, vai sem histórico nenhum.     */
+/* ============================================================= */
+size_t salvarSnapshot(const Jogo *j, unsigned char *dest, size_t capacidade) {
+    size_t total = tamanhoSnapshot(j);
+    if (capacidade < total) return 0;
+    unsigned char *corpo = dest + sizeof(CabecalhoSnapshot);
+    size_t n;
+    if (j->ramoAtual != NULL) {                   // A arena própria só refaz a partir de outro ponto
+        Jogo semHistorico = *j;
+        esvaziarLog(&semHistorico.historico);
+        n = serializarKeyframe(&semHistorico, 0, corpo);
+    } else {
+        n = serializarKeyframe(j, 0, corpo);
+    }
+    if (j->tabuleiro != NULL) { memcpy(corpo + n, j->tabuleiro, sizeof(Tabuleiro)); n += sizeof(Tabuleiro); }
+
+    CabecalhoSnapshot c = { {'T', 'S', 'S', 'N'}, VERSAO_SNAPSHOT, MARCA_ORDEM_BYTES,
+                            TAM_FILA, TAM_PILHA, LARGURA_TAB, ALTURA_TAB,
+                            j->tabuleiro != NULL ? FOTOS_TABULEIRO : 0, n, somaVerificacao(corpo, n) };
+    memcpy(dest, &c, sizeof c);
+    return total;
+}
+
+/* ============================================================= */
+/*  Função: restaurarSnapshot()                                  */
+/*  O contrário: "j" (um jogo iniciado, ou já liberado) vira a  */
+/*  sessão salva. Tudo é conferido e alocado antes de mexer no  */
+/*  jogo: se der erro (inclusive SNAPSHOT_MEMORIA), ele         */
+/*  continua como estava. A arena do desfazer e o               */
+/*  tabuleiro que o jogo já tem são reaproveitados quando       */
+/*  servem. Alimentador e ramo não vêm (são religados por quem  */
+/*  chama); a análise (se houver) continua ligada.              */
+/*  Devolve SNAPSHOT_OK ou o SNAPSHOT_* do problema.            */
+/* ============================================================= */
+int restaurarSnapshot(Jogo *j, const unsigned char *orig, size_t tam) {
+    CabecalhoSnapshot c;
+    if (tam < sizeof c) return SNAPSHOT_TRUNCADO;
+    memcpy(&c, orig, sizeof c);
+    if (memcmp(c.magica, "TSSN", 4) != 0 || c.ordemBytes != MARCA_ORDEM_BYTES) return SNAPSHOT_FORMATO;
+    if (c.versao != VERSAO_SNAPSHOT) return SNAPSHOT_VERSAO;
+    if (c.tamFila != TAM_FILA || c.tamPilha != TAM_PILHA || c.larguraTab != LARGURA_TAB || c.alturaTab != ALTURA_TAB
+        || (c.fotosTabuleiro != 0 && c.fotosTabuleiro != FOTOS_TABULEIRO)) return SNAPSHOT_CONFIG;
+    if (c.tamanho > tam - sizeof c) return SNAPSHOT_TRUNCADO;
+    const unsigned char *corpo = orig + sizeof c;
+    if (somaVerificacao(corpo, c.tamanho) != c.verificacao) return SNAPSHOT_CORROMPIDO;
+    size_t bytesTabuleiro = c.fotosTabuleiro != 0 ? sizeof(Tabuleiro) : 0;
+    if (c.tamanho < bytesTabuleiro || !keyframeValido(corpo, c.tamanho - bytesTabuleiro)) return SNAPSHOT_CORROMPIDO;
+
+    Tabuleiro *antigo = j->tabuleiro;             // Fica com o de antes (se houver): sem malloc
+    Tabuleiro *t = antigo;
+    if (bytesTabuleiro > 0 && t == NULL && (t = malloc(sizeof(Tabuleiro))) == NULL) return SNAPSHOT_MEMORIA;
+    j->tabuleiro = NULL;                          // O liberarJogo do restaurarKeyframe não solta o tabuleiro
+    if (restaurarKeyframe(j, corpo, c.tamanho - bytesTabuleiro) < 0) {
+        j->tabuleiro = antigo;                    // Nada mudou no jogo
+        if (t != antigo) free(t);
+        return SNAPSHOT_MEMORIA;
+    }
+    if (bytesTabuleiro > 0) {
+        memcpy(t, corpo + c.tamanho - bytesTabuleiro, sizeof(Tabuleiro));
+        j->tabuleiro = t;
+    } else {
+        free(t);
+    }
+    return SNAPSHOT_OK;
+}
+
+#ifdef TEM_COMPACTO
+/* ============================================================= */
+/*  Função: montarCabecalhoTabela()                              */
+/*  Preenche o cabeçalho de uma tabela de decisão já calculada  */
+/*  (qtdEstadosTabela() estados, dois por byte)                 */
+/* ============================================================= */
+void montarCabecalhoTabela(CabecalhoTabela *c, const unsigned char *decisoes, int horizonte) {
+    uint64_t qtd = qtdEstadosTabela();
+    CabecalhoTabela novo = { {'T', 'S', 'T', 'D'}, VERSAO_TABELA, MARCA_ORDEM_BYTES, TAM_FILA, TAM_PILHA,
+                             (uint16_t)horizonte, 0, qtd, somaVerificacao(decisoes, (qtd + 1) / 2) };
+    *c = novo;
+}
+
+/* ============================================================= */
+/*  Função: usarTabela()                                         */
+/*  Confere uma tabela inteira na memória (arquivo mapeado ou   */
+/*  array compilado junto) e aponta "t" para as decisões dela,  */
+/*  sem copiar. Os bytes precisam continuar valendo enquanto    */
+/*  "t" for usada. Devolve SNAPSHOT_OK ou o SNAPSHOT_* do erro. */
+/* ============================================================= */
+int usarTabela(TabelaDecisao *t, const unsigned char *orig, size_t tam) {
+    CabecalhoTabela c;
+    if (tam < sizeof c) return SNAPSHOT_TRUNCADO;
+    memcpy(&c, orig, sizeof c);
+    if (memcmp(c.magica, "TSTD", 4) != 0 || c.ordemBytes != MARCA_ORDEM_BYTES) return SNAPSHOT_FORMATO;
+    if (c.versao != VERSAO_TABELA) return SNAPSHOT_VERSAO;
+    if (c.tamFila != TAM_FILA || c.tamPilha != TAM_PILHA || c.qtdEstados != qtdEstadosTabela()) return SNAPSHOT_CONFIG;
+    size_t bytes = (size_t)((c.qtdEstados + 1) / 2);
+    if (bytes > tam - sizeof c) return SNAPSHOT_TRUNCADO;
+    const unsigned char *decisoes = orig + sizeof c;
+    if (somaVerificacao(decisoes, bytes) != c.verificacao) return SNAPSHOT_CORROMPIDO;
+    t->decisoes = decisoes;
+    t->qtdEstados = c.qtdEstados;
+    t->horizonte = c.horizonte;
+    return SNAPSHOT_OK;
+}
+#endif
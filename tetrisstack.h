@@ -0,0 +1,821 @@
+/* ============================================================= */
+/*  TETRIS STACK – BIBLIOTECA (libtetrisstack)                  */
+/* ============================================================= */
+/*  O motor do jogo inteiro (fila, reserva, desfazer, gerador,  */
+/*  tabuleiro, gravação...) sem nenhum main(). Os três níveis,  */
+/*  o simulador, a busca e o servidor são só "casca" em volta   */
+/*  dele; um serviço pode fazer o mesmo e rodar partidas dentro */
+/*  do próprio processo, sem abrir um programa por partida.     */
+/*                                                               */
+/*    make                → libtetrisstack.a, libtetrisstack.so */
+/*                          e os programas                      */
+/*    #include "tetrisstack.h"  +  -ltetrisstack -pthread       */
+/*                                                               */
+/*  TAM_FILA, TAM_PILHA, LARGURA_TAB... são fixados na          */
+/*  compilação: quem usa a biblioteca precisa compilar com os   */
+/*  MESMOS -D dela (o layout do Jogo depende deles). O          */
+/*  conferirBiblioteca() pega a diferença na hora de rodar.     */
+/* ============================================================= */
+
+#ifndef TETRISSTACK_H
+#define TETRISSTACK_H
+
+#include <stdio.h>      // FILE (a gravação escreve num arquivo)
+#include <stddef.h>     // offsetof (conferir o layout do Jogo)
+#include <stdint.h>     // uint64_t (gerador, estado compacto)
+#include <pthread.h>    // pthread_t (alimentador e gravação usam threads)
+#include <stdatomic.h>  // atômicos do anel do alimentador
+#ifdef TETRIS_METRICAS
+#include <signal.h>     // sig_atomic_t (pedido de métricas pelo SIGUSR1)
+#endif
+
+#define VERSAO_TETRISSTACK 3          // Sobe quando o layout do Jogo ou a API mudam
+
+/* ------------------- MODO SILENCIOSO (--batch) --------------- */
+// No modo batch nenhuma mensagem é impressa: o custo do printf seria maior
+// que o custo da própria jogada. As funções de ação usam MSG() no lugar de printf().
+extern int modoSilencioso;            // 0 = jogo normal (imprime), 1 = batch (não imprime nada)
+#define MSG(...) do { if (!modoSilencioso) mensagem(__VA_ARGS__); } while (0)
+
+/* ------------------- LINHA DE STATUS ------------------------ */
+// As mensagens das ações ("Jogou peça [I 5]", "Reserva cheia!"...) não
+// vão direto para o terminal: elas se juntam numa linha de status que
+// quem desenha a tela mostra como quiser (o Mestre, embaixo do menu).
+#define COLUNAS_TELA 512              // Bytes por linha da tela (as molduras usam 3 bytes por caractere)
+extern char linhaStatus[COLUNAS_TELA];   // Mensagens da última ação
+extern size_t tamStatus;              // Quantos bytes da linha de status estão ocupados
+
+void mensagem(const char *formato, ...);
+void limparStatus(void);
+
+/* ------------------- DEFINIÇÃO DO TIPO "PEÇA" ---------------- */
+// Crio um "molde" chamado Peca que representa uma peça do Tetris.
+// O pack(1) tira os 3 bytes de "enchimento" que o compilador colocaria
+// entre nome e id: a peça ocupa 5 bytes em vez de 8, e assim a fila, a
+// pilha e os índices de um jogo cabem juntos em 64 bytes (veja Jogo).
+//
+// O id de verdade tem 64 bits (uma partida longa passa de 4 bilhões de
+// peças), mas a peça só guarda os 32 bits de baixo: o resto sai do
+// contador do jogo (veja idPeca()).
+#pragma pack(push, 1)
+typedef struct {
+    char nome;   // Guarda a letra da peça: 'I', 'O', 'T', 'L', 'J', 'S' ou 'Z'
+    uint32_t id; // Número único que cada peça recebe quando é criada (os 32 bits de baixo)
+} Peca;          // Agora posso criar variáveis do tipo Peca em qualquer lugar
+#pragma pack(pop)
+
+// "Nenhuma peça": a vaga vazia nas jogadas do aplicarAcoes. Quem marca é
+// o nome 0 (nenhuma peça de verdade tem); o id vem junto para não ficar lixo
+#define ID_NENHUMA   UINT32_MAX
+#define PECA_NENHUMA ((Peca){ 0, ID_NENHUMA })
+
+/* ------------------- CONFIGURAÇÕES DA FILA (Next Queue) ------ */
+// Os tamanhos podem ser trocados na compilação, sem mexer no código:
+//   make CFLAGS="-O2 -DTAM_FILA=7 -DTAM_PILHA=5"
+// Cada combinação gera um programa com as constantes "embutidas".
+#ifndef TAM_FILA
+#define TAM_FILA 5                    // A fila sempre tem exatamente 5 posições
+#endif
+
+// O array da fila tem tamanho potência de 2 (ARMAZ_FILA >= TAM_FILA).
+// Assim "dar a volta" é um E bit a bit com a máscara, em vez de uma
+// divisão (%): (4 + 1) & 7 = 5, (7 + 1) & 7 = 0. A fila continua tendo
+// só TAM_FILA peças; as posições a mais ficam só de folga.
+#define ARMAZ_FILA (TAM_FILA <= 1 ? 1 : TAM_FILA <= 2 ? 2 : TAM_FILA <= 4 ? 4 : \
+                    TAM_FILA <= 8 ? 8 : TAM_FILA <= 16 ? 16 : 32)
+#define MASCARA_FILA (ARMAZ_FILA - 1)
+_Static_assert(TAM_FILA >= 1 && TAM_FILA <= 32, "TAM_FILA precisa estar entre 1 e 32");
+
+/* ------------------- CONFIGURAÇÕES DA PILHA (Hold) ---------- */
+#ifndef TAM_PILHA
+#define TAM_PILHA 3                   // A reserva (Hold) aceita no máximo 3 peças
+#endif
+_Static_assert(TAM_PILHA >= 1 && TAM_PILHA <= 127, "TAM_PILHA precisa estar entre 1 e 127");
+
+/* ------------------- HISTÓRICO PARA O "DESFAZER" (UNDO/REDO) - */
+// Estrutura que guarda uma "foto" completa do jogo em um momento.
+// A foto é tirada antes de cada ação (na pilha de chamadas, não no
+// jogo); depois da ação ela é comparada com o jogo e só o que mudou
+// (o "delta") vai para o histórico.
+typedef struct {
+    Peca fila_salva[ARMAZ_FILA];      // Cópia completa da fila
+    int frente_salvo, tras_salvo, qtdFila_salvo;  // Cópia dos índices e quantidade
+    Peca pilha_salva[TAM_PILHA];      // Cópia completa da pilha
+    int topo_salvo, qtdPilha_salvo;   // Cópia do topo e quantidade da pilha
+    unsigned pousos_salvo;            // Peças já pousadas no tabuleiro (se o jogo tiver um)
+} Estado;                             // Um "Estado" é uma foto do jogo inteiro
+
+// O histórico é um buffer circular de bytes (a "arena") que cresce
+// dobrando de tamanho até o orçamento de bytes. Cada ação vira um
+// registro de tamanho variável:
+//
+//   [tam] [índices antes (5)] [índices depois (5)] [n]
+//         n × { posição, peça antes (5), peça depois (5) } [tam]
+//
+// O tamanho aparece nas duas pontas para dar para andar para trás
+// (desfazer) e para frente (refazer). Se a ação pousou peças no
+// tabuleiro, vai junto um slot a mais com a posição POS_TABULEIRO e,
+// no lugar da "peça antes", quantas peças pousaram (o tabuleiro guarda
+// as fotos dele; o registro só diz quantas voltar ou avançar). Sem as
+// fotos (mais de FOTOS_TABULEIRO pousos para trás, ou antes de uma
+// bifurcação), o desfazer para ali com RESULTADO_SEM_FOTO. Quando o orçamento acaba, os
+// registros mais antigos são descartados: custo O(1) por ação e memória
+// limitada, não importa quanto tempo dure a partida.
+#define ORCAMENTO_DESFAZER_PADRAO (64 * 1024)   // Bytes (padrão; mude com --undo-budget)
+#define CAPACIDADE_INICIAL_LOG 256              // A arena começa pequena e cresce sob demanda
+#define BYTES_PECA 5                            // nome (1) + id (4)
+#define BYTES_INDICES 5                         // frente, tras, qtdFila, topo+1, qtdPilha
+#define BYTES_SLOT (1 + 2 * BYTES_PECA)         // posição + peça antes + peça depois
+#define POS_TABULEIRO 255                       // Slot do tabuleiro (não é posição da fila nem da pilha)
+#define MAX_REGISTRO (2 + 2 * BYTES_INDICES + 1 + (ARMAZ_FILA + TAM_PILHA + 1) * BYTES_SLOT)
+_Static_assert(MAX_REGISTRO <= 255, "o tamanho do registro precisa caber em 1 byte (fila/pilha grandes demais)");
+
+typedef struct {
+    unsigned char *dados;             // A arena (buffer circular)
+    size_t capacidade;                // Sempre potência de 2 → posição física = pos & (capacidade-1)
+    size_t orcamento;                 // Máximo de bytes que a arena pode ocupar
+    size_t inicio;                    // Onde começa o registro mais antigo (posição que só cresce)
+    size_t cursor;                    // Fim da última ação feita: desfazer anda para trás daqui
+    size_t fim;                       // Fim das ações que ainda podem ser refeitas
+    int qtdDesfazer;                  // Quantas ações podem ser desfeitas agora
+    int qtdRefazer;                   // Quantas ações desfeitas podem ser refeitas
+} LogDesfazer;
+
+/* ------------------- GERADOR DE PEÇAS ----------------------- */
+extern const char tiposPeca[7];       // As 7 peças do Tetris
+
+// Letra → tipo (0 a 6, a posição em tiposPeca)
+static inline int tipoDaLetra(char nome) {
+    for (int t = 0; t < 7; t++) if (tiposPeca[t] == nome) return t;
+    return 0;
+}
+
+// Em vez do rand() da biblioteca (estado global escondido, lento e com
+// viés no "% 7"), cada jogo tem o SEU gerador, com semente explícita.
+// O núcleo é o xoshiro256** (rápido e de boa qualidade): a mesma
+// semente dá sempre a mesma sequência de peças → replays reproduzíveis.
+#define MODO_ALEATORIO 0              // Cada peça sorteada sozinha (1/7 de chance para cada tipo)
+#define MODO_SACO      1              // "7-bag": as 7 peças embaralhadas, sai uma de cada por saco
+#define LOTE_PECAS 64                 // Quantas peças cada jogo prepara de uma vez (gerarTiposEmLote aceita qualquer n)
+
+typedef struct {
+    uint64_t s[4];                    // Estado do xoshiro256**
+    int modo;                         // MODO_ALEATORIO ou MODO_SACO
+    unsigned char saco[7];            // Saco atual (só no MODO_SACO)
+    int posSaco;                      // Próxima peça do saco (7 = saco vazio, embaralha outro)
+    unsigned char lote[LOTE_PECAS];   // Tipos (0 a 6) já gerados, esperando para virar peça
+    int posLote;                      // Próximo tipo do lote a ser usado
+} GeradorPecas;
+
+/* ------------------- O JOGO (uma sessão) --------------------- */
+// Tudo que antes eram variáveis globais agora mora aqui dentro. Cada
+// função recebe um "Jogo *j", então um programa pode ter quantos jogos
+// quiser ao mesmo tempo (um por jogador), sem um processo para cada.
+//
+// A parte "quente" (o que toda jogada lê e escreve) vem primeiro e, na
+// configuração padrão, ocupa exatamente uma linha de cache de 64 bytes:
+//   fila 8×5 + pilha 3×5 + 5 índices + proximoId = 40 + 15 + 5 + 4 = 64
+// O gerador e o histórico ficam depois, na parte "fria".
+typedef struct {
+    /* ---- parte quente ---- */
+    _Alignas(64) Peca fila[ARMAZ_FILA];   // Array que guarda as próximas TAM_FILA peças
+    Peca pilha[TAM_PILHA];            // Array que guarda as peças reservadas
+    uint8_t frente;                   // Índice da peça que vai cair AGORA (primeira da fila)
+    uint8_t tras;                     // Índice onde será colocada a próxima peça nova
+    uint8_t qtdFila;                  // Quantas peças estão na fila no momento
+    uint8_t qtdPilha;                 // Quantas peças estão reservadas agora
+    int8_t  topo;                     // -1 significa pilha vazia. Quando tem peça, vira 0, 1 ou 2
+    uint32_t proximoId;               // Contador que dá ID único para cada peça (32 bits de baixo)
+
+    /* ---- parte fria ---- */
+    GeradorPecas gerador;             // O gerador de peças deste jogo
+    uint32_t epocaId;                 // Os 32 bits de cima do contador de ids (sobe a cada 2^32 peças)
+    LogDesfazer historico;            // Desfazer/refazer deste jogo
+    struct AlimentadorPecas *alimentador;  // Thread que gera as peças adiantado (NULL = gera aqui)
+    struct Tabuleiro *tabuleiro;      // Onde as peças jogadas caem (NULL = só fila e reserva)
+    struct AnalisePecas *analise;     // Auditoria das peças geradas (NULL = nenhuma)
+    struct Ramo *ramo;                // Histórico congelado de onde este jogo saiu (NULL = nenhum)
+    size_t pontoRamo;                 // Onde, no ramo, começa a arena própria deste jogo
+    struct Ramo *ramoAtual;           // Se desfez para dentro dos Ramos: em qual está (NULL = na arena própria)
+    size_t cursorRamo;                // ...e em que posição dele
+} Jogo;
+
+#if TAM_FILA <= 8 && TAM_PILHA <= 3
+_Static_assert(offsetof(Jogo, gerador) <= 64, "a parte quente do Jogo deve caber em uma linha de cache");
+#endif
+
+/* ------------------- IDS DE 64 BITS ------------------------- */
+// O contador inteiro é epocaId:proximoId. Uma peça viva guarda só os
+// 32 bits de baixo do id dela; como ela saiu há menos de 2^32 peças,
+// a distância até o contador (em 32 bits, dando a volta) diz o resto.
+// Para isso valer sempre, a cada 2^31 peças geradas o jogo dá id novo
+// às peças que estão há mais de 2^31 peças paradas na reserva (é raro:
+// ficar 2 bilhões de peças sem usar a reserva). Um desfazer que volte
+// por cima dessa troca devolve o id antigo.
+#define METADE_IDS 0x80000000u
+
+static inline uint64_t proximoIdCompleto(const Jogo *j) {
+    return ((uint64_t)j->epocaId << 32) | j->proximoId;
+}
+
+// O id de 64 bits de uma peça que está (ou acabou de sair) do jogo
+static inline uint64_t idPeca(const Jogo *j, Peca p) {
+    return proximoIdCompleto(j) - (uint32_t)(j->proximoId - p.id);
+}
+
+/* ------------------- RESULTADO DAS AÇÕES --------------------- */
+// Cada ação devolve um destes códigos: 0 = deu certo, o resto diz por
+// que ela foi recusada (as mesmas mensagens que o jogador vê).
+#define RESULTADO_OK               0
+#define RESULTADO_FILA_VAZIA       1  // "Fila vazia!"
+#define RESULTADO_RESERVA_CHEIA    2  // "Reserva cheia!"
+#define RESULTADO_RESERVA_VAZIA    3  // "Reserva vazia!"
+#define RESULTADO_TROCA_IMPOSSIVEL 4  // "Não é possível trocar..."
+#define RESULTADO_NADA_DESFAZER    5  // "Nada para desfazer!"
+#define RESULTADO_NADA_REFAZER     6  // "Nada para refazer!"
+#define RESULTADO_ACAO_INVALIDA    7  // Código fora de 1 a 7 (executarAcao, aplicarAcoes)
+#define RESULTADO_SEM_FOTO         8  // "O tabuleiro não volta mais que isso!" (desfazer)
+#define QTD_RESULTADOS             9
+
+extern const char *nomesResultado[QTD_RESULTADOS];   // Nome de cada código ("ok", "fila_vazia"...)
+
+/* ============================================================= */
+/*  Função: proximoAleatorio()                                   */
+/*  Um passo do xoshiro256**: devolve 64 bits aleatórios        */
+/* ============================================================= */
+static inline uint64_t rotl64(uint64_t x, int k) { return (x << k) | (x >> (64 - k)); }
+
+static inline uint64_t proximoAleatorio(GeradorPecas *g) {
+    uint64_t *s = g->s;
+    uint64_t resultado = rotl64(s[1] * 5, 7) * 9;
+    uint64_t t = s[1] << 17;
+    s[2] ^= s[0]; s[3] ^= s[1]; s[1] ^= s[2]; s[0] ^= s[3];
+    s[2] ^= t;
+    s[3] = rotl64(s[3], 45);
+    return resultado;
+}
+
+/* ============================================================= */
+/*  Função: sortearAte()                                         */
+/*  Número de 0 a n-1 SEM viés (método de Lemire: multiplica e  */
+/*  descarta a pequena faixa que deixaria uns números com mais  */
+/*  chance que outros)                                           */
+/* ============================================================= */
+static inline uint32_t sortearAte(GeradorPecas *g, uint32_t n) {
+    uint64_t m = (proximoAleatorio(g) >> 32) * n;
+    if ((uint32_t)m < n) {                        // Caso raro: pode estar na faixa com viés
+        uint32_t limite = (uint32_t)(-n) % n;
+        while ((uint32_t)m < limite) m = (proximoAleatorio(g) >> 32) * n;
+    }
+    return (uint32_t)(m >> 32);
+}
+
+/* ============================================================= */
+/*  ALIMENTADOR DE PEÇAS (thread produtora, opcional)            */
+/* ============================================================= */
+// Com o alimentador ligado, encher o lote de peças deixa de ser
+// trabalho do jogo: uma thread produtora gera lotes de LOTE_PECAS tipos
+// adiantado e os coloca num anel SPSC (um produtor, um consumidor) sem
+// lock nem espera. Quando o lote do jogo acaba, gerarPeca() só copia o
+// próximo lote pronto.
+//
+//   - "cabeca" (só o produtor escreve) e "cauda" (só o consumidor
+//     escreve) ficam em linhas de cache separadas: um não invalida a
+//     linha do outro a cada lote
+//   - cada lote leva junto o estado do gerador DEPOIS dele: o gerador
+//     do jogo fica exatamente igual ao que seria sem o alimentador
+//     (gravação, espiarTipos e o resumo continuam valendo)
+//   - o lote número k é sempre o mesmo, não importa quem o gere. Se o
+//     anel estiver vazio, o jogo gera o lote na hora com o PRÓPRIO
+//     gerador (que já está no estado depois do último lote que ele
+//     pegou) e avança a cauda: é uma "falta", e ninguém espera ninguém.
+//     O produtor que ficou para trás (cabeca < cauda) descarta os lotes
+//     que o jogo já fez, em vez de publicá-los
+#ifndef ANEL_FEED
+#define ANEL_FEED 16                  // Lotes prontos no anel (potência de 2)
+#endif
+_Static_assert((ANEL_FEED & (ANEL_FEED - 1)) == 0, "ANEL_FEED precisa ser potência de 2");
+
+typedef struct {
+    _Alignas(64) unsigned char tipos[LOTE_PECAS];
+    uint64_t s[4];                    // Estado do gerador depois deste lote
+    unsigned char saco[7];
+    int posSaco;
+} LoteFeed;
+
+typedef struct AlimentadorPecas {
+    _Alignas(64) _Atomic uint64_t cabeca;     // Próximo lote a ser escrito (produtor)
+    _Alignas(64) _Atomic uint64_t cauda;      // Próximo lote a ser lido (consumidor)
+    _Alignas(64) _Atomic int rodando;
+    GeradorPecas gerador;                     // Gerador do produtor (só a thread dele mexe)
+    pthread_t thread;
+    unsigned long long faltas;                // Lotes que o jogo teve de gerar sozinho
+    LoteFeed anel[ANEL_FEED];
+} AlimentadorPecas;
+
+/* ============================================================= */
+/*  TABULEIRO (bitboard: uma linha = um uint16_t)                */
+/* ============================================================= */
+// Com um tabuleiro ligado (ligarTabuleiro), as peças jogadas param de
+// só "sumir": cada uma cai no campo de LARGURA_TAB × ALTURA_TAB, as
+// linhas completas são apagadas e a partida ganha pontos de verdade.
+//
+// Cada linha do campo é um uint16_t: o bit c ligado = coluna c ocupada
+// (bit 0 = coluna da esquerda), linha 0 = a de baixo. Uma peça também
+// é só 4 linhas de bits, então:
+//   - as 4 linhas da peça cabem num uint64_t (16 bits cada), e as 4
+//     linhas do campo onde ela está também: colisão = um E de 64 bits
+//   - mover para a direita = shift; cair = descer o índice da linha
+//   - linha completa = linha == CAMPO_CHEIO; com SSE2 o campo inteiro
+//     (32 linhas) é conferido em 4 comparações de 8 linhas
+//
+// O jogador do Tetris Stack não escolhe posição, então o próprio jogo
+// escolhe onde a peça cai (escolherEncaixe): testa todas as rotações
+// e colunas e fica com a que deixa o campo melhor (menos buracos,
+// menos altura, mais linhas feitas). Quem quiser outra estratégia
+// chama soltarPeca() direto com a rotação e a coluna.
+#ifndef LARGURA_TAB
+#define LARGURA_TAB 10                // Colunas (no máximo 16: uma linha é um uint16_t)
+#endif
+#ifndef ALTURA_TAB
+#define ALTURA_TAB 20                 // Linhas visíveis
+#endif
+_Static_assert(LARGURA_TAB >= 4 && LARGURA_TAB <= 16, "LARGURA_TAB precisa estar entre 4 e 16");
+_Static_assert(ALTURA_TAB >= 4 && ALTURA_TAB <= 28, "ALTURA_TAB precisa estar entre 4 e 28");
+
+#define LINHAS_CAMPO 32               // ALTURA_TAB + 4 de folga (a peça que passa do topo), arredondado
+#define CAMPO_CHEIO ((uint16_t)((1u << LARGURA_TAB) - 1))
+#ifndef FOTOS_TABULEIRO
+#define FOTOS_TABULEIRO 1024          // Quantos pousos o desfazer consegue voltar no tabuleiro (além disso: RESULTADO_SEM_FOTO)
+#endif
+_Static_assert((FOTOS_TABULEIRO & (FOTOS_TABULEIRO - 1)) == 0, "FOTOS_TABULEIRO precisa ser potência de 2");
+
+typedef struct {
+    uint16_t linhas[LINHAS_CAMPO];    // O campo: linha 0 embaixo
+    int altura;                       // Linhas ocupadas (a mais alta com algum bloco + 1)
+    unsigned pecas;                   // Peças pousadas
+    unsigned linhasFeitas;            // Linhas apagadas
+    unsigned derrotas;                // Vezes que o campo encheu (e recomeçou vazio)
+    unsigned long long pontos;
+} Campo;
+
+typedef struct Tabuleiro {
+    Campo campo;                      // O campo de agora
+    unsigned cursor;                  // Pousos feitos (menos os desfeitos): a próxima foto vai em cursor
+    int qtdVoltar, qtdAvancar;        // Fotos que o desfazer/refazer ainda têm
+    Campo fotos[FOTOS_TABULEIRO];     // Campo de antes de cada pouso (buffer circular)
+} Tabuleiro;
+
+/* ============================================================= */
+/*  ESTADO COMPACTO (fila + pilha em um único uint64_t)          */
+/* ============================================================= */
+// Para busca e simulação só importa o TIPO de cada peça (7 tipos →
+// 3 bits). Então a fila e a pilha inteiras cabem num número de 64 bits:
+//
+//   bits  0 .. 3*TAM_FILA-1   → tipos da fila, a frente nos 3 bits mais baixos
+//   bits  3*TAM_FILA .. 55    → tipos da pilha, o FUNDO primeiro (topo = último)
+//   bits 56 .. 59             → qtdFila
+//   bits 60 .. 63             → qtdPilha
+//
+// Os ids não ficam aqui: são só o contador de ids de quem chama
+// (cada peça nova recebe o próximo número). Copiar, comparar ou fazer
+// hash de um estado vira uma operação de um registrador, e milhões de
+// estados cabem na cache L2.
+//
+// Cada função recebe o estado e devolve o novo estado. As que
+// colocam peça nova na fila recebem o tipo dela ("novo", de 0 a 6);
+// se a ação não for possível, o estado volta igual (quem chama só
+// consome o "novo" do gerador se o estado mudou).
+#if 3 * (TAM_FILA + TAM_PILHA) <= 56 && TAM_FILA <= 15 && TAM_PILHA <= 15
+#define TEM_COMPACTO 1
+
+typedef uint64_t EstadoCompacto;
+
+#define BITS_TIPO          3
+#define DESLOC_PILHA_C     (BITS_TIPO * TAM_FILA)
+#define DESLOC_QTD_FILA_C  56
+#define DESLOC_QTD_PILHA_C 60
+#define MASCARA_BITS(n)    ((n) >= 64 ? ~0ULL : (1ULL << (n)) - 1)   // Os n bits mais baixos ligados
+#define CAMPO_FILA_C       MASCARA_BITS(DESLOC_PILHA_C)
+#define CAMPO_PILHA_C      (MASCARA_BITS(BITS_TIPO * TAM_PILHA) << DESLOC_PILHA_C)
+
+static inline int compactoQtdFila(EstadoCompacto e)  { return (int)((e >> DESLOC_QTD_FILA_C) & 15); }
+static inline int compactoQtdPilha(EstadoCompacto e) { return (int)(e >> DESLOC_QTD_PILHA_C); }
+static inline int compactoFrente(EstadoCompacto e)   { return (int)(e & 7); }
+static inline int compactoTopo(EstadoCompacto e) {
+    return (int)((e >> (DESLOC_PILHA_C + BITS_TIPO * (compactoQtdPilha(e) - 1))) & 7);
+}
+
+/* ------------------- Fila: enqueue / dequeue ----------------- */
+static inline EstadoCompacto compactoEnqueue(EstadoCompacto e, int novo) {
+    e |= (uint64_t)novo << (BITS_TIPO * compactoQtdFila(e));    // Entra logo depois da última
+    return e + (1ULL << DESLOC_QTD_FILA_C);
+}
+static inline EstadoCompacto compactoDequeue(EstadoCompacto e) {
+    // A fila anda 3 bits para a direita: a frente some, a 2ª vira frente
+    return (((e & CAMPO_FILA_C) >> BITS_TIPO) | (e & ~CAMPO_FILA_C)) - (1ULL << DESLOC_QTD_FILA_C);
+}
+
+/* ------------------- As ações do menu ------------------------ */
+// Opção 1 – Jogar a peça da frente
+static inline EstadoCompacto compactoJogar(EstadoCompacto e, int novo) {
+    if (compactoQtdFila(e) == 0) return e;
+    return compactoEnqueue(compactoDequeue(e), novo);
+}
+
+// Opção 2 – Reservar (frente da fila vai para o topo da pilha)
+static inline EstadoCompacto compactoReservar(EstadoCompacto e, int novo) {
+    int qP = compactoQtdPilha(e);
+    if (compactoQtdFila(e) == 0 || qP >= TAM_PILHA) return e;
+    uint64_t frente = e & 7;
+    e = compactoDequeue(e);
+    e |= frente << (DESLOC_PILHA_C + BITS_TIPO * qP);
+    e += 1ULL << DESLOC_QTD_PILHA_C;
+    return compactoEnqueue(e, novo);
+}
+
+// Opção 3 – Usar reservada (sai o topo da pilha e a frente da fila)
+static inline EstadoCompacto compactoUsarReservada(EstadoCompacto e, int novo) {
+    int qP = compactoQtdPilha(e);
+    if (qP == 0 || compactoQtdFila(e) == 0) return e;
+    e &= ~(7ULL << (DESLOC_PILHA_C + BITS_TIPO * (qP - 1)));     // Apaga o topo
+    e -= 1ULL << DESLOC_QTD_PILHA_C;
+    return compactoEnqueue(compactoDequeue(e), novo);
+}
+
+// Opção 4 – Trocar topo da pilha com a frente da fila
+static inline EstadoCompacto compactoTrocar(EstadoCompacto e) {
+    int qP = compactoQtdPilha(e);
+    if (qP == 0 || compactoQtdFila(e) == 0) return e;
+    int desloc = DESLOC_PILHA_C + BITS_TIPO * (qP - 1);
+    uint64_t x = (e ^ (e >> desloc)) & 7;                        // Troca por XOR: a^b nos dois lugares
+    return e ^ x ^ (x << desloc);
+}
+
+// Troca de bloco (mesmas regras de trocarBloco): os k primeiros tipos
+// da fila trocam com os k do topo da pilha. Como a pilha é guardada do
+// fundo para o topo e a fila da frente para o fim, cada bloco entra no
+// outro lugar com a ordem invertida.
+static inline uint64_t inverterCampos(uint64_t v, int k) {
+    uint64_t r = 0;
+    for (int i = 0; i < k; i++) { r = (r << BITS_TIPO) | (v & 7); v >>= BITS_TIPO; }
+    return r;
+}
+
+static inline EstadoCompacto compactoTrocarBloco(EstadoCompacto e, int k) {
+    int qF = compactoQtdFila(e), qP = compactoQtdPilha(e);
+    if (k > qP) k = qP;
+    if (k > qF) k = qF;
+    if (k <= 0) return e;
+    int baseTopo = DESLOC_PILHA_C + BITS_TIPO * (qP - k);
+    uint64_t mascara = MASCARA_BITS(BITS_TIPO * k);
+    uint64_t frente = e & mascara;
+    uint64_t topo = (e >> baseTopo) & mascara;
+    e &= ~(mascara | (mascara << baseTopo));
+    return e | inverterCampos(topo, k) | (inverterCampos(frente, k) << baseTopo);
+}
+
+// Opção 6 – Inverter fila com pilha: a reserva inteira
+static inline EstadoCompacto compactoInverter(EstadoCompacto e) {
+    return compactoTrocarBloco(e, compactoQtdPilha(e));
+}
+
+/* ------------------- Conversão e hash ------------------------ */
+// Tira o "retrato compacto" de um jogo (só os tipos, sem os ids)
+EstadoCompacto compactar(const Jogo *j);
+
+// Hash de um estado compacto: uma multiplicação e um deslocamento
+static inline uint64_t hashCompacto(EstadoCompacto e) {
+    e *= 0x9E3779B97F4A7C15ULL;
+    return e ^ (e >> 32);
+}
+#endif
+
+/* ============================================================= */
+/*  GRAVAÇÃO E REPLAY (arquivo binário .tsr)                     */
+/* ============================================================= */
+// Cada partida pode ser gravada num arquivo compacto:
+//
+//   [cabeçalho 32 bytes]  "TSRP", versão, config, semente, orçamento
+//   [bloco 0] [bloco 1] ... [bloco n-1]
+//   [índice]  n × { passo (8), posição do bloco no arquivo (8) }
+//   [rodapé 32 bytes]     n, posição do índice, total de passos, "TSRI"
+//
+// Cada bloco começa com um "keyframe" (o jogo inteiro naquele passo:
+// parte quente, gerador, época dos ids e histórico do desfazer)
+// seguido das ações dos próximos INTERVALO_KEYFRAME passos, 3 bits
+// cada (códigos 1 a 7).
+//
+// Para ir direto ao passo P, o leitor mapeia o arquivo (mmap), faz
+// busca binária no índice pelo último keyframe <= P, restaura esse
+// keyframe e refaz no máximo INTERVALO_KEYFRAME ações: O(log n), não
+// importa o tamanho da partida.
+//
+// Os números são gravados na ordem de bytes da máquina (o cabeçalho
+// guarda uma marca para detectar arquivos de máquinas diferentes).
+//
+// A escrita em disco é feita por uma thread separada, com dois
+// buffers: o jogo enche um enquanto a thread grava o outro. O jogo só
+// espera se o disco estiver um bloco inteiro atrasado.
+#ifndef INTERVALO_KEYFRAME
+#define INTERVALO_KEYFRAME 16384      // Passos entre dois keyframes (seek refaz no máximo isso)
+#endif
+#define VERSAO_GRAVACAO 2             // 2: o keyframe leva a época dos ids (epocaId)
+#define MARCA_ORDEM_BYTES 0x0102      // Lida como 0x0201 numa máquina de ordem trocada
+#define BYTES_HOT offsetof(Jogo, gerador)
+#define BYTES_FIXOS_KEYFRAME (4 + 8 + BYTES_HOT + sizeof(GeradorPecas) + 4 + 8 + 8 + 4 + 4 + 4 + 4)
+
+typedef struct {
+    char magica[4];                   // "TSRP"
+    uint16_t versao;
+    uint16_t ordemBytes;
+    uint8_t tamFila, tamPilha, modo, reservado;
+    uint32_t intervalo;               // INTERVALO_KEYFRAME de quem gravou
+    uint64_t semente;
+    uint64_t orcamento;
+} CabecalhoGravacao;
+
+typedef struct {
+    uint64_t qtdKeyframes;
+    uint64_t posicaoIndice;
+    uint64_t totalPassos;
+    char magica[4];                   // "TSRI"
+    uint32_t reservado;
+} RodapeGravacao;
+
+_Static_assert(sizeof(CabecalhoGravacao) == 32 && sizeof(RodapeGravacao) == 32, "layout do arquivo .tsr");
+
+typedef struct {
+    FILE *arquivo;
+    pthread_t thread;
+    pthread_mutex_t trava;
+    pthread_cond_t sinal;
+    unsigned char *buffers[2];        // O jogo enche um, a thread grava o outro
+    size_t tamanhos[2];               // Bytes prontos em cada buffer
+    int pronto[2];                    // 1 = esperando a thread gravar
+    int atual;                        // Buffer que o jogo está enchendo
+    int encerrar;                     // Pede para a thread terminar
+    int erro;                         // A thread não conseguiu gravar
+    int parou;                        // Faltou memória para o índice: as ações seguintes não são gravadas
+    size_t capacidadeBuffer;
+    size_t usado;                     // Bytes no buffer atual
+    size_t inicioAcoes;               // Onde começam as ações dentro do buffer atual
+    uint64_t posicao;                 // Posição no arquivo do começo do buffer atual
+    uint64_t passos;                  // Ações gravadas até agora
+    uint64_t *indice;                 // Pares (passo, posição)
+    size_t qtdIndice, capIndice;
+} Gravador;
+
+/* ------------------- SNAPSHOT DA SESSÃO --------------------- */
+// Uma sessão inteira num bloco de bytes, para suspender e continuar
+// depois (ou em outro processo da mesma máquina):
+//
+//   [cabeçalho 32 bytes]  "TSSN", versão, config, tamanho, soma
+//   [keyframe]            o mesmo da gravação: parte quente, gerador,
+//                         época dos ids e histórico do desfazer
+//   [tabuleiro]           o Tabuleiro inteiro (só se o jogo tiver um)
+//
+// Salvar e restaurar são memcpy + uma soma de verificação de 64 bits,
+// sem alocar nada quando o jogo de destino já tem arena e tabuleiro
+// do mesmo tamanho. A soma pega arquivo estragado, não adulterado:
+// restaure só snapshots de origem confiável.
+#define VERSAO_SNAPSHOT 1
+
+typedef struct {
+    char magica[4];                   // "TSSN"
+    uint16_t versao;
+    uint16_t ordemBytes;              // MARCA_ORDEM_BYTES
+    uint8_t tamFila, tamPilha, larguraTab, alturaTab;
+    uint32_t fotosTabuleiro;          // FOTOS_TABULEIRO de quem salvou (0 = sem tabuleiro)
+    uint64_t tamanho;                 // Bytes depois do cabeçalho
+    uint64_t verificacao;             // Soma de verificação desses bytes
+} CabecalhoSnapshot;
+_Static_assert(sizeof(CabecalhoSnapshot) == 32, "layout do snapshot");
+
+#define SNAPSHOT_OK          0
+#define SNAPSHOT_TRUNCADO    1
+#define SNAPSHOT_FORMATO     2
+#define SNAPSHOT_VERSAO      3
+#define SNAPSHOT_CONFIG      4
+#define SNAPSHOT_CORROMPIDO  5
+#define SNAPSHOT_MEMORIA     6
+#define QTD_ERROS_SNAPSHOT   7
+
+extern const char *mensagensSnapshot[QTD_ERROS_SNAPSHOT];   // O que dizer para cada SNAPSHOT_*
+
+/* ------------------- TABELA DE DECISÃO ---------------------- */
+// A melhor jogada (1, 2, 3, 4 ou 6) para CADA estado compacto de fila
+// cheia, calculada uma vez fora do jogo (./busca --build-table) e
+// consultada depois com um acesso só, no lugar de uma busca por jogada:
+//
+//   [cabeçalho 32 bytes]  "TSTD", versão, config, horizonte, soma
+//   [decisões]            4 bits por estado, dois estados por byte
+//
+// O índice de um estado é um número em base 7: a fila primeiro (a
+// frente é o dígito mais alto, a peça que acabou de entrar o mais
+// baixo), depois a pilha, agrupada pelo tamanho dela. Com TAM_FILA 5 e
+// TAM_PILHA 3 são 7^5 * (1 + 7 + 49 + 343) = 6.722.800 estados (3,4 MB).
+// Como a peça nova é o último dígito, os 7 filhos de uma jogada ficam
+// lado a lado na tabela: é isso que deixa o gerador rápido.
+//
+// O arquivo pode ser lido com mmap (abrir e conferir custam pouco) ou
+// virar um array C compilado junto (--c-header): usarTabela() aceita
+// os dois. Os erros são os mesmos SNAPSHOT_* (e mensagensSnapshot).
+#ifdef TEM_COMPACTO
+#define VERSAO_TABELA 1
+
+typedef struct {
+    char magica[4];                   // "TSTD"
+    uint16_t versao;
+    uint16_t ordemBytes;              // MARCA_ORDEM_BYTES
+    uint8_t tamFila, tamPilha;
+    uint16_t horizonte;               // Jogadas que o gerador olhou à frente
+    uint32_t reservado;
+    uint64_t qtdEstados;
+    uint64_t verificacao;             // Soma de verificação das decisões
+} CabecalhoTabela;
+_Static_assert(sizeof(CabecalhoTabela) == 32, "layout da tabela");
+
+typedef struct {
+    const unsigned char *decisoes;    // Dentro do arquivo/array de quem chamou (não é copiado)
+    uint64_t qtdEstados;
+    int horizonte;
+} TabelaDecisao;
+
+static inline uint64_t potencia7(int n) {
+    uint64_t p = 1;
+    while (n-- > 0) p *= 7;
+    return p;
+}
+
+// Estados com a fila cheia e a pilha com 0 a TAM_PILHA peças
+static inline uint64_t qtdEstadosTabela(void) {
+    return potencia7(TAM_FILA) * ((potencia7(TAM_PILHA + 1) - 1) / 6);
+}
+
+// Posição do estado na tabela (só vale com a fila cheia)
+static inline uint64_t indiceTabela(EstadoCompacto e) {
+    uint64_t fila = 0, pilha = 0, antes = 0, grupo = 1;
+    for (int c = 0; c < TAM_FILA; c++) fila = fila * 7 + ((e >> (BITS_TIPO * c)) & 7);
+    int qP = compactoQtdPilha(e);
+    for (int c = 0; c < qP; c++) { antes += grupo; grupo *= 7; }   // Estados com pilha menor
+    for (int c = qP - 1; c >= 0; c--) pilha = pilha * 7 + ((e >> (DESLOC_PILHA_C + BITS_TIPO * c)) & 7);
+    return (antes + pilha) * potencia7(TAM_FILA) + fila;
+}
+
+static inline int decisaoNoIndice(const unsigned char *decisoes, uint64_t i) {
+    return (decisoes[i >> 1] >> (4 * (i & 1))) & 15;
+}
+
+// A jogada guardada para "e", ou 0 se o estado não está na tabela
+// (fila incompleta)
+static inline int consultarTabela(const TabelaDecisao *t, EstadoCompacto e) {
+    if (compactoQtdFila(e) != TAM_FILA) return 0;
+    return decisaoNoIndice(t->decisoes, indiceTabela(e));
+}
+#endif
+
+/* ------------------- ANÁLISE DAS PEÇAS ---------------------- */
+// Estatísticas do fluxo de tipos em memória constante: veja
+// analisarTipos(). Um jogo com "analise" ligada soma cada lote que gera.
+#define BALDES_SECA 64                // Secas de 0 a 62 peças, uma por balde; o último é "63 ou mais"
+#define BALDES_SEQUENCIA 16           // Sequências de 1 a 15 iguais; o último é "16 ou mais"
+
+typedef struct AnalisePecas {
+    unsigned long long total;                      // Tipos analisados
+    unsigned long long contagem[7];                // Quantos de cada tipo
+    unsigned long long ultimaPos[7];               // Posição + 1 do último de cada tipo (0 = nunca)
+    unsigned long long secas[7][BALDES_SECA];      // Histograma das secas de cada tipo
+    unsigned long long somaSecas[7], maiorSeca[7];
+    unsigned long long sequencias[BALDES_SEQUENCIA];   // Histograma das sequências (todos os tipos)
+    unsigned long long maiorSequencia;
+    int tipoMaiorSequencia;
+    int tipoAnterior;                              // Último tipo visto (-1 = nenhum)
+    unsigned long long sequencia;                  // Tamanho da sequência em andamento
+} AnalisePecas;
+
+/* ------------------- LEITURA DE AÇÕES ----------------------- */
+// Entrada bufferizada no lugar do scanf("%d"): veja lerNumero()
+#define TAM_LEITOR (64 * 1024)        // Bytes lidos por read()
+
+typedef struct {
+    int fd;                           // De onde lê (STDIN_FILENO, um socket...)
+    int fim;                          // 1 = a entrada acabou
+    int terminal;                     // 1 = fd é um terminal (esvazia o stdout antes de ler)
+    size_t pos, tam;                  // Próximo byte e bytes válidos no buffer
+    unsigned long long malformados;   // Palavras que não eram número (puladas)
+    unsigned long long foraDoMenu;    // Números que não eram ação (só no lerAcoes)
+    unsigned char buf[TAM_LEITOR];
+} LeitorAcoes;
+
+/* ============================================================= */
+/*  MÉTRICAS (só com -DTETRIS_METRICAS; veja tetrisstack.c)     */
+/* ============================================================= */
+extern int formatoMetricas;           // 0 = nada, 1 = JSON, 2 = Prometheus
+extern const char *arquivoMetricas;   // NULL = stderr
+
+#ifdef TETRIS_METRICAS
+extern volatile sig_atomic_t pedidoMetricas;   // Ligado pelo SIGUSR1
+void iniciarMetricas(const Jogo *j, int formatoJson, const char *arquivo);
+void exportarMetricas(void);
+
+// Chamada no laço principal: exporta se chegou um SIGUSR1
+static inline void verificarPedidoMetricas(void) {
+    if (pedidoMetricas) { pedidoMetricas = 0; exportarMetricas(); }
+}
+#else
+static inline void verificarPedidoMetricas(void) { }
+#endif
+
+void ligarMetricas(const Jogo *j);
+void terminarMetricas(void);
+
+/* ============================================================= */
+/*  AS FUNÇÕES DA BIBLIOTECA                                     */
+/* ============================================================= */
+/* ---- Gerador de peças ---- */
+void iniciarGerador(GeradorPecas *g, uint64_t semente, int modo);
+void separarFluxo(GeradorPecas *novo, GeradorPecas *base);
+void gerarTiposEmLote(GeradorPecas *g, unsigned char *destino, size_t n);
+void espiarTipos(const GeradorPecas *g, unsigned char *destino, int n);
+Peca gerarPeca(Jogo *j);
+int ligarAlimentador(Jogo *j);        // 1 = thread produtora ligada
+void desligarAlimentador(Jogo *j);
+
+/* ---- Análise das peças ---- */
+void iniciarAnalise(AnalisePecas *a);
+void analisarTipos(AnalisePecas *a, const unsigned char *tipos, size_t n);
+double quiQuadrado(const AnalisePecas *a, double *p);
+void imprimirAnalise(const AnalisePecas *a, FILE *saida, int detalhado);
+
+/* ---- Um jogo (sessão) ---- */
+void iniciarJogo(Jogo *j, const GeradorPecas *gerador);
+void liberarJogo(Jogo *j);
+int bifurcarJogo(Jogo *novo, Jogo *origem);
+void juntarRamo(Jogo *destino, Jogo *ramo);
+int conferirBiblioteca(int versao, int tamFila, int tamPilha, size_t tamJogo);
+
+/* ---- Fila e reserva ---- */
+void enqueue(Jogo *j);
+Peca dequeue(Jogo *j);
+
+/* ---- As ações do menu (devolvem um RESULTADO_*) ---- */
+int jogarPeca(Jogo *j);
+int reservarPeca(Jogo *j);
+int usarReservada(Jogo *j);
+int trocarTopoComFrente(Jogo *j);
+int trocarBloco(Jogo *j, int k);
+int inverterFilaComPilha(Jogo *j);
+int desfazer(Jogo *j);
+int refazer(Jogo *j);
+int executarAcao(Jogo *j, int op);
+size_t aplicarAcoes(Jogo *j, const unsigned char *acoes, size_t n, unsigned char *resultados, Peca *jogadas);
+
+/* ---- Histórico ---- */
+void salvarEstado(const Jogo *j, Estado *foto);
+void registrarDelta(Jogo *j, const Estado *antes);
+
+/* ---- Tabuleiro ---- */
+void limparCampo(Campo *c);
+uint32_t linhasCompletas(const Campo *c);
+int soltarPeca(Campo *c, int tipo, int rotacao, int coluna);
+int avaliarCampo(const Campo *c);
+void escolherEncaixe(const Campo *c, int tipo, int *rotacao, int *coluna);
+int ligarTabuleiro(Jogo *j);          // 1 = tabuleiro ligado
+void desligarTabuleiro(Jogo *j);
+
+/* ---- Exibição e resumo ---- */
+int formatarFila(const Jogo *j, char *dest, size_t tam);
+int formatarPilha(const Jogo *j, char *dest, size_t tam);
+void exibirFila(const Jogo *j);
+void exibirPilha(const Jogo *j);
+unsigned long long resumoEstado(const Jogo *j);
+
+/* ---- Leitura de ações ---- */
+void iniciarLeitor(LeitorAcoes *l, int fd);
+int lerNumero(LeitorAcoes *l, int *valor);   // 1 = número, -1 = palavra inválida, 0 = fim
+size_t lerAcoes(LeitorAcoes *l, unsigned char *codigos, size_t max, int *sair);
+
+/* ---- Gravação ---- */
+size_t serializarKeyframe(const Jogo *j, uint64_t passo, unsigned char *dest);
+long long restaurarKeyframe(Jogo *j, const unsigned char *orig, size_t tam);   // -1 = memória, -2 = keyframe errado
+int abrirGravacao(Gravador *g, const char *caminho, const Jogo *j, uint64_t semente, int modo);
+void gravarAcao(Gravador *g, const Jogo *j, int op);
+int fecharGravacao(Gravador *g);
+
+/* ---- Snapshot ---- */
+size_t tamanhoSnapshot(const Jogo *j);
+size_t salvarSnapshot(const Jogo *j, unsigned char *dest, size_t capacidade);
+int restaurarSnapshot(Jogo *j, const unsigned char *orig, size_t tam);   // SNAPSHOT_*
+
+/* ---- Tabela de decisão ---- */
+#ifdef TEM_COMPACTO
+void montarCabecalhoTabela(CabecalhoTabela *c, const unsigned char *decisoes, int horizonte);
+int usarTabela(TabelaDecisao *t, const unsigned char *orig, size_t tam);   // SNAPSHOT_*
+#endif
+
+// Confere, na hora de rodar, se o programa foi compilado com a mesma
+// configuração (TAM_FILA, TAM_PILHA...) da biblioteca que carregou
+#define CONFERIR_BIBLIOTECA() conferirBiblioteca(VERSAO_TETRISSTACK, TAM_FILA, TAM_PILHA, sizeof(Jogo))
+
+#endif